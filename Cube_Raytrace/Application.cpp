@@ -5,6 +5,10 @@
 #include <fstream>
 #include <string>
 #include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <memory>
 #include <assert.h>
 #include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp"
@@ -13,129 +17,85 @@
 #include "vendor/stb_image.h"
 #include <vector>
 #include "objloader.hpp"
+#include "renderer.hpp"
+#include "volumetexture.hpp"
+#include "brickatlas.hpp"
+#include "distancefield.hpp"
+#include "raysetup.hpp"
+#include "preintegration.hpp"
+#include "shaderprogram.hpp"
+#include "programcache.hpp"
+#include "shadercompiler.hpp"
+#include "lighting.hpp"
+#include "rendermode.hpp"
+#include "progressive.hpp"
+#include "dynamicresolution.hpp"
+#include "batchrender.hpp"
+#include "glcontext.hpp"
+#include "pngwriter.hpp"
 glm::mat4 rotate = glm::mat4(1.0f);
 float angx = 0.0f, angy = 0.0f, angz = 0.0f;
-#define ASSERT(x) if (!(x)) assert(false)
-#define GLCall(x) GLClearError();\
-    x;\
-    ASSERT(GLCheckError())
 glm::vec3 key_brd(0.0f, 0.0f, 0.0f);
 glm::vec3 vscale(1.0f, 1.0f, 1.0f);
+bool lodEnabled = true;
+int skipMode = 2;
+const char* skipModeNames[] = { "off", "macro-cells", "distance field" };
+float windowLowShift = 0.0f;
+int rayMode = 0;
+int compositing = 1;
+bool adaptiveStep = true;
+float stepScale = 1.0f;
+bool preIntegrated = false;
+// Pre-integration needs the colormap; false when it could not be loaded.
+bool preIntegrationAvailable = true;
+float opacityCutoff = 0.0f;
+const char* rayModeNames[] = { "per-fragment box intersection", "rasterized cube", "rasterized brick proxy" };
+float lodBias = 0.0f;
+RenderMode renderMode = RenderMode::Composite;
+float isoValue = 0.5f;
+bool shading = false;
+bool progressive = true;
+// Set by any key press; restarts progressive accumulation.
+bool sceneChanged = false;
 
 void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods);
 static void cursorPos(GLFWwindow *window, double xPos, double yPos);
 GLFWwindow* window;
 
-static void GLClearError()
-{
-	while (glGetError() != GL_NO_ERROR);
-}
-
-static bool GLCheckError()
-{
-	while (GLenum error = glGetError())
-	{
-
-		std::cout << "[OpenGL Error] ";
-		switch (error) {
-		case GL_INVALID_ENUM:
-			std::cout << "GL_INVALID_ENUM : An unacceptable value is specified for an enumerated argument.";
-			break;
-		case GL_INVALID_VALUE:
-			std::cout << "GL_INVALID_OPERATION : A numeric argument is out of range.";
-			break;
-		case GL_INVALID_OPERATION:
-			std::cout << "GL_INVALID_OPERATION : The specified operation is not allowed in the current state.";
-			break;
-		case GL_INVALID_FRAMEBUFFER_OPERATION:
-			std::cout << "GL_INVALID_FRAMEBUFFER_OPERATION : The framebuffer object is not complete.";
-			break;
-		case GL_OUT_OF_MEMORY:
-			std::cout << "GL_OUT_OF_MEMORY : There is not enough memory left to execute the command.";
-			break;
-		case GL_STACK_UNDERFLOW:
-			std::cout << "GL_STACK_UNDERFLOW : An attempt has been made to perform an operation that would cause an internal stack to underflow.";
-			break;
-		case GL_STACK_OVERFLOW:
-			std::cout << "GL_STACK_OVERFLOW : An attempt has been made to perform an operation that would cause an internal stack to overflow.";
-			break;
-		default:
-			std::cout << "Unrecognized error" << error;
-		}
-		std::cout << std::endl;
-		return false;
-	}
-	return true;
-}
-
-static unsigned int CompileShader(unsigned int type, const std::string& source)
-{
-	GLCall(unsigned int id = glCreateShader(type));
-	const char* src = source.c_str();
-	GLCall(glShaderSource(id, 1, &src, nullptr));
-	GLCall(glCompileShader(id));
-
-	// Error handling
-	int result;
-	GLCall(glGetShaderiv(id, GL_COMPILE_STATUS, &result));
-	std::cout << (type == GL_VERTEX_SHADER ? "vertex" : "fragment") << " shader compile status: " << result << std::endl;
-	if (result == GL_FALSE)
-	{
-		int length;
-		GLCall(glGetShaderiv(id, GL_INFO_LOG_LENGTH, &length));
-		char* message = (char*)alloca(length * sizeof(char));
-		GLCall(glGetShaderInfoLog(id, length, &length, message));
-		std::cout
-			<< "Failed to compile "
-			<< (type == GL_VERTEX_SHADER ? "vertex" : "fragment")
-			<< "shader"
-			<< std::endl;
-		std::cout << message << std::endl;
-		GLCall(glDeleteShader(id));
-		return 0;
-	}
-
-	return id;
-}
-
 int main(int argc, char* argv[])
 {
 	unsigned int m_RendererID(0);
 	unsigned int m_RendererIDn(0);
-	if (!glfwInit())
-	{
-		fprintf(stderr, "Failed to initialize GLFW\n");
-		getchar();
-		return -1;
+	// "batch=<views>" renders a list of views to PNGs on the CPU and never
+	// opens a window, so it runs on machines without a display.
+	for (int i = 1; i < argc; i++)
+		if (strncmp(argv[i], "batch=", 6) == 0)
+			return runBatch(argc, argv);
+	// "headless" renders into an offscreen framebuffer through EGL, as does
+	// a machine on which no window can be opened.
+	bool headless = false;
+	for (int i = 1; i < argc; i++)
+		headless = headless || strcmp(argv[i], "headless") == 0;
+	std::unique_ptr<GLContext> context;
+	if (!headless)
+		context = createGLContext(GLContextBackend::Window, 1024, 768, "Raycast");
+	if (!context) {
+		if (!headless)
+			fprintf(stderr, "Falling back to a headless context\n");
+		context = createGLContext(GLContextBackend::Headless, 1024, 768, "Raycast");
 	}
-
-	glfwWindowHint(GLFW_SAMPLES, 4);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-	window = glfwCreateWindow(1024, 768, "Raycast", NULL, NULL);
-	if (window == NULL) {
-		fprintf(stderr, "Failed to open GLFW window. If you have an Intel GPU, they are not 3.3 compatible. Try the 2.1 version of the tutorials.\n");
+	if (!context) {
 		getchar();
-		glfwTerminate();
 		return -1;
 	}
-	glfwMakeContextCurrent(window);
-	glfwSetKeyCallback(window, keyCallback);
-	glfwSetInputMode(window, GLFW_STICKY_KEYS, 1);
-	glfwSetCursorPosCallback(window, cursorPos);
-	//	glfwSetCursorEnterCallback(window, cursorEnterCallback);
-		// Initialize GLEW
-	glewExperimental = true;
-	if (glewInit() != GLEW_OK) {
-		fprintf(stderr, "Failed to initialize GLEW\n");
-		getchar();
-		glfwTerminate();
-		return -1;
+	double startupStart = context->time();
+	window = context->window();
+	if (window) {
+		glfwSetKeyCallback(window, keyCallback);
+		glfwSetInputMode(window, GLFW_STICKY_KEYS, GL_TRUE);
+		glfwSetCursorPosCallback(window, cursorPos);
+		//	glfwSetCursorEnterCallback(window, cursorEnterCallback);
 	}
-	glfwSetInputMode(window, GLFW_STICKY_KEYS, GL_TRUE);
 	//glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
 
 /*	float positions[] = {
@@ -203,43 +163,149 @@ int main(int argc, char* argv[])
 	unsigned char* m_LocalBuffer_color;
 	m_LocalBuffer_color = new unsigned char[180 * 1 * 4];
 	m_LocalBuffer_color = stbi_load("res/textures/matplotlib-virdis.png", &m_Width, &m_Height, &m_BPP, 4);
+	if (m_LocalBuffer_color == nullptr) {
+		printf("Could not load the colormap, pre-integration disabled\n");
+		preIntegrationAvailable = false;
+	}
 	//************Reading the raw data**************
-	unsigned char* m_LocalBuffer = new unsigned char[128 * 128 * 128 * 1];
+	// Raytrace [volume.raw dx dy dz type [half]], type one of uint8, uint16,
+	// int32, float32 (or the matching GL_ enum name); "half" stores float
+	// volumes as GL_R16F. A bricked volume is opened with
+	// Raytrace volume.bvol [half] [paged], dims and type come from its header;
+	// "paged" streams bricks through a fixed-size atlas even when the whole
+	// volume would fit in the texture budget. "mip" (or mip=max) ingests a
+	// mip pyramid of a raw volume and samples coarser levels for distant or
+	// widely spaced samples; L toggles it, [ and ] shift the level bias.
+	// E cycles empty-space skipping between off, the macro-cell min/max grid
+	// and the distance field; Page Up/Down raise and lower the window's low end.
+	// R cycles the ray setup between per-fragment box intersection and the
+	// rasterized entry/exit pass over cube.obj or over the visible bricks.
+	// C switches between front-to-back and the legacy additive compositing,
+	// A toggles adaptive stepping and , and . halve and double the base step.
+	// I toggles the pre-integrated transfer function; O and P lower and raise
+	// the value below which samples are fully transparent.
+	// M cycles the render mode between composite, maximum, minimum and
+	// average intensity projection and the first-hit isosurface; J and K
+	// lower and raise the isovalue.
+	// Linked programs are cached as driver binaries in shadercache/;
+	// "nocache" compiles them from source and leaves the cache alone.
+	// "gradients" (or gradients=sobel) precomputes a gradient volume, packed
+	// as RGBA8 or with "rgb10a2" as GL_RGB10_A2, that shading reads instead
+	// of taking six extra samples per gradient.
+	// H toggles Phong shading of the visible samples and of the isosurface.
+	// G toggles progressive refinement. "budget=<ms>" times the GPU work of
+	// every frame and scales the render target and step size of interactive
+	// frames to keep it within that many milliseconds. Accumulation passes
+	// that would not fit that budget, or 16 ms without it, are drawn in
+	// strips over several frames so input is still read every frame. "headless" renders without a
+	// window until the image has converged, or for "frames=<n>" frames, and
+	// "screenshot=<png>" saves the last frame, for benchmarks and regression
+	// images on machines without a display or GPU.
 	const char* path = "res/textures/cube_128x128x128.raw";
-	unsigned int r, g, b;
-	int dx = 128;//atoi(argv[2]);
-	int dy = 128;//atoi(argv[3]);
-	int dz = 128;//atoi(argv[4]);
-	const char* type = "GL_INT";//argv[5];
-	unsigned long fileLen;
-	int *fileBuf;
-	FILE *file = fopen(path, "r");
-	fseek(file, 0, SEEK_END);
-	fileLen = ftell(file);
-	fseek(file, 0, SEEK_SET);
-	fileBuf = new int[fileLen / sizeof(GL_INT)];
-	unsigned int size_type = sizeof(type);
-	fread(fileBuf, size_type, dx * dy * dz, file);
-	float min = fileBuf[0];
-	float max = fileBuf[0];
-
-	for (int i = 0; i < dx * dy * dz; i++)
-	{
-
-		if (min > fileBuf[i])
-			min = fileBuf[i];
-		if (max < fileBuf[i])
-			max = fileBuf[i];
-	}
-
-	for (int i = 0; i < dx * dy * dz; i++)
-	{
-		r = 255 * ((fileBuf[i] - min) / (max - min));
-		m_LocalBuffer[i] = (unsigned char)r;
-	}
-	std::cout << "min " << min;
-	std::cout << "max " << max;
-	int volDims[3] = { 128, 128, 128 };
+	int dx = 128;
+	int dy = 128;
+	int dz = 128;
+	const char* type = "GL_INT";
+	bool halfFloat = false;
+	bool paged = false;
+	MipFilter mips = MipFilter::None;
+	GradientSettings gradients;
+	double budgetMs = 0.0;
+	int frameLimit = 0;
+	const char* screenshotPath = nullptr;
+	int flagsBegin = argc;
+	size_t pathLength = argc >= 2 ? strlen(argv[1]) : 0;
+	bool bricked = pathLength > 5 && strcmp(argv[1] + pathLength - 5, ".bvol") == 0;
+	if (bricked) {
+		path = argv[1];
+		flagsBegin = 2;
+	}
+	else if (argc >= 6) {
+		path = argv[1];
+		dx = atoi(argv[2]);
+		dy = atoi(argv[3]);
+		dz = atoi(argv[4]);
+		type = argv[5];
+		flagsBegin = 6;
+	}
+	for (int i = flagsBegin; i < argc; i++)
+	{
+		if (strcmp(argv[i], "half") == 0)
+			halfFloat = true;
+		else if (bricked && strcmp(argv[i], "paged") == 0)
+			paged = true;
+		else if (!bricked && strcmp(argv[i], "mip") == 0)
+			mips = MipFilter::Average;
+		else if (!bricked && strncmp(argv[i], "mip=", 4) == 0 && !parseMipFilter(argv[i] + 4, mips))
+			fprintf(stderr, "Unknown mip filter %s, expected none, average or max\n", argv[i] + 4);
+		else if (strcmp(argv[i], "nocache") == 0)
+			setProgramCacheEnabled(false);
+		else if (strcmp(argv[i], "gradients") == 0)
+			gradients.enabled = true;
+		else if (strncmp(argv[i], "gradients=", 10) == 0) {
+			gradients.enabled = true;
+			if (!parseGradientFilter(argv[i] + 10, gradients.filter))
+				fprintf(stderr, "Unknown gradient filter %s, expected central or sobel\n", argv[i] + 10);
+		}
+		else if (strcmp(argv[i], "rgb10a2") == 0)
+			gradients.format = GradientFormat::RGB10A2;
+		else if (strncmp(argv[i], "budget=", 7) == 0)
+			budgetMs = atof(argv[i] + 7);
+		else if (strncmp(argv[i], "frames=", 7) == 0)
+			frameLimit = atoi(argv[i] + 7);
+		else if (strncmp(argv[i], "screenshot=", 11) == 0)
+			screenshotPath = argv[i] + 11;
+	}
+	VoxelType voxelType;
+	if (!bricked && (!parseVoxelType(type, voxelType) || dx <= 0 || dy <= 0 || dz <= 0)) {
+		fprintf(stderr, "Usage: %s [volume.raw dx dy dz uint8|uint16|int32|float32 [half] [mip|mip=max] [nocache] [gradients[=sobel] [rgb10a2]] [budget=ms] [headless] [frames=n] [screenshot=png]]\n", argv[0]);
+		fprintf(stderr, "       %s volume.bvol [half] [paged] [nocache] [gradients[=sobel] [rgb10a2]] [budget=ms] [headless] [frames=n] [screenshot=png]\n", argv[0]);
+		getchar();
+		return -1;
+	}
+	// The raw file is mapped rather than read and uploaded in its native
+	// precision (GL_R8/GL_R16/GL_R16F/GL_R32F); window/level normalization
+	// happens in the fragment shader. Of a bricked volume only the bricks
+	// that rise above the volume minimum are read at all, and a volume larger
+	// than the texture budget is paged in through a brick atlas.
+	const size_t atlasBudget = (size_t)1 << 30;
+	VolumeTexture volumeTexture;
+	BrickVolume brickVolume;
+	std::unique_ptr<BrickAtlas> atlas;
+	bool loaded;
+	if (bricked) {
+		loaded = openBrickVolume(path, brickVolume);
+		if (loaded) {
+			const BrickVolumeHeader& header = *brickVolume.header;
+			VolumeTextureFormat format = selectVolumeTextureFormat((VoxelType)header.voxelType, halfFloat);
+			size_t fullBytes = (size_t)header.dims[0] * header.dims[1] * header.dims[2] * format.bytesPerTexel;
+			if (paged || fullBytes > atlasBudget) {
+				// Keep about twice the atlas' worth of bricks decoded on the CPU side.
+				size_t slotBytes = (size_t)brickStoredSize(header) * brickStoredSize(header) * brickStoredSize(header) * format.bytesPerTexel;
+				atlas.reset(new BrickAtlas(brickVolume, atlasBudget, 2 * (atlasBudget / slotBytes), halfFloat));
+				for (int a = 0; a < 3; a++)
+					volumeTexture.dims[a] = (int)header.dims[a];
+				volumeTexture.format = atlas->format();
+				volumeTexture.range = brickVolumeRange(brickVolume);
+				macroCellsFromBricks(brickVolume, volumeTexture.cells);
+			}
+			else {
+				loaded = createVolumeTexture(brickVolume, brickVolumeRange(brickVolume).min, halfFloat, gradients, volumeTexture);
+			}
+		}
+	}
+	else
+		loaded = createVolumeTexture(path, dx, dy, dz, voxelType, halfFloat, mips, gradients, volumeTexture);
+	if (!loaded) {
+		getchar();
+		return -1;
+	}
+	dx = volumeTexture.dims[0];
+	dy = volumeTexture.dims[1];
+	dz = volumeTexture.dims[2];
+	VolumeRange range = volumeTexture.range;
+	std::cout << "min " << range.min;
+	std::cout << "max " << range.max;
 	unsigned int vao;
 	GLCall(glGenVertexArrays(1, &vao));
 	GLCall(glBindVertexArray(vao));
@@ -265,57 +331,43 @@ int main(int argc, char* argv[])
 	GLCall(glGenBuffers(1, &ibo));
 	GLCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo));
 
-	std::ifstream stream("res/shader/Basic.shader");
-	std::string line;
-	std::stringstream ss[2];
-	int Shadertype = -1;
-
-	while (getline(stream, line))
+	// Every render mode is its own permutation of Basic.shader, and the
+	// composite mode one per compositing. All of them are submitted up front
+	// and built in the background, so switching modes only binds another
+	// program; uniforms are set on whichever program is current each frame. Until the current mode's program is linked the
+	// bounding box is drawn with Fallback.shader.
+	double shadersStart = context->time();
+	std::unique_ptr<ShaderCompiler> shaderCompiler(new ShaderCompiler(*context));
+	int raymarchPrograms[renderModeCount];
+	int compositePrograms[compositingCount];
+	std::vector<int> submittedPrograms;
+	for (int m = 0; m < renderModeCount; m++)
 	{
-		if (line.find("#shader") != std::string::npos)
-		{
-			if (line.find("vertex") != std::string::npos)
-				Shadertype = 0;
-			else if (line.find("fragment") != std::string::npos)
-				Shadertype = 1;
-		}
-		else
+		int variants = (RenderMode)m == RenderMode::Composite ? compositingCount : 1;
+		for (int c = 0; c < variants; c++)
 		{
-			ss[Shadertype] << line << '\n';
+			std::vector<std::string> defines = { renderModeDefine((RenderMode)m) };
+			if (variants > 1)
+				defines.push_back(compositingDefine((Compositing)c));
+			if (volumeTexture.gradientId != 0)
+				defines.push_back("GRADIENT_PRECOMPUTED");
+			int program = shaderCompiler->Submit("res/shader/Basic.shader", defines);
+			if (variants > 1)
+				compositePrograms[c] = program;
+			submittedPrograms.push_back(program);
 		}
+		raymarchPrograms[m] = submittedPrograms.back();
 	}
-	unsigned int shader = glCreateProgram();
-	unsigned int vs = CompileShader(GL_VERTEX_SHADER, ss[0].str());
-	unsigned int fs = CompileShader(GL_FRAGMENT_SHADER, ss[1].str());
-
-	GLCall(glAttachShader(shader, vs));
-	GLCall(glAttachShader(shader, fs));
-	GLCall(glLinkProgram(shader));
-	GLint program_linked;
-	GLCall(glGetProgramiv(shader, GL_LINK_STATUS, &program_linked));
-	std::cout << "Program link status: " << program_linked << std::endl;
-	if (program_linked != GL_TRUE)
-	{
-		GLsizei log_length = 0;
-		GLchar message[1024];
-		GLCall(glGetProgramInfoLog(shader, 1024, &log_length, message));
-		std::cout << "Failed to link program" << std::endl;
-		std::cout << message << std::endl;
-	}
-
-	GLCall(glValidateProgram(shader));
-	GLCall(glDeleteShader(vs));
-	GLCall(glDeleteShader(fs));
-	GLCall(unsigned int u_ColorMap = glGetUniformLocation(shader, "colormap"));
-	GLCall(unsigned int u_Text = glGetUniformLocation(shader, "u_Texture"));
-
-
-	GLCall(unsigned int volume_dims = glGetUniformLocation(shader, "volume_dims"));
+	std::unique_ptr<ShaderProgram> fallbackProgram(new ShaderProgram("res/shader/Fallback.shader"));
+	ShaderProgram* shader = fallbackProgram.get();
+	bool shadersReported = false;
+	LightingBlock lighting;
+	unsigned int lightingBuffer = createLightingBuffer();
 	GLCall(glUseProgram(0));
 	GLCall(glBindBuffer(GL_ARRAY_BUFFER, 0));
 	GLCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
 	GLCall(glBindVertexArray(0));
-	GLCall(glUseProgram(shader));
+	shader->Bind();
 	GLCall(glBindVertexArray(vao));
 	GLCall(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo));
 
@@ -324,20 +376,55 @@ int main(int argc, char* argv[])
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	//glMatrixMode(GL_MODELVIEW);
-	glm::vec3 view = glm::vec3(0.15f,0.15f,0.15f);
 	glm::mat4 model(1.0f);
 	//-----------------Raw_data----------------------------
-	GLCall(glGenTextures(1, &m_RendererID));
-	GLCall(glBindTexture(GL_TEXTURE_3D, m_RendererID));
-	//GLCall(glTexStorage3D(GL_TEXTURE_3D,1, GL_R8,128,128,128));
-	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
-	GLCall(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER));
-	GLCall(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER));
-	GLCall(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_BORDER));
-	GLCall(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
-	GLCall(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
-	GLCall(glTexImage3D(GL_TEXTURE_3D, 0, GL_RGB, 128, 128, 128, 0, GL_RED, GL_UNSIGNED_BYTE, m_LocalBuffer));
-	GLCall(glBindTexture(GL_TEXTURE_3D, 0));
+	m_RendererID = atlas ? atlas->atlasTexture() : volumeTexture.id;
+	const MacroCellGrid& cells = volumeTexture.cells;
+	unsigned int macroCellTexture = createMacroCellTexture(cells, volumeTexture.format.valueScale);
+	size_t emptyCells = 0;
+	for (size_t i = 0; i < cells.cellCount(); i++)
+		if (cells.minMax[i * 2 + 1] <= range.min)
+			emptyCells++;
+	printf("Macro-cells %dx%dx%d of %d voxels, %.1f%% empty at the volume minimum\n", cells.dims[0], cells.dims[1], cells.dims[2],
+		cells.cellSize, 100.0 * emptyCells / std::max<size_t>(1, cells.cellCount()));
+	std::unique_ptr<DistanceField> distanceField(new DistanceField(cells));
+
+	// Two-pass ray setup: the entry/exit pass rasterizes cube.obj (or the
+	// proxy around visible macro-cells) and the raymarch pass covers the
+	// screen with a quad that reads the result.
+	float boxMin[3] = { vertices[0].x, vertices[0].y, vertices[0].z };
+	float boxMax[3] = { boxMin[0], boxMin[1], boxMin[2] };
+	for (const glm::vec3& v : vertices)
+		for (int a = 0; a < 3; a++)
+		{
+			boxMin[a] = std::min(boxMin[a], v[a]);
+			boxMax[a] = std::max(boxMax[a], v[a]);
+		}
+	float boxSize[3] = { boxMax[0] - boxMin[0], boxMax[1] - boxMin[1], boxMax[2] - boxMin[2] };
+	std::unique_ptr<ShaderProgram> rayProgram(new ShaderProgram("res/shader/RaySetup.shader"));
+	rayProgram->Bind();
+	rayProgram->SetUniform3f("u_BoxMin", boxMin[0], boxMin[1], boxMin[2]);
+	rayProgram->SetUniform3f("u_BoxSize", boxSize[0], boxSize[1], boxSize[2]);
+	shader->Bind();
+	std::unique_ptr<RaySetup> raySetup(new RaySetup());
+	std::vector<float> cubePositions;
+	for (const glm::vec3& v : vertices)
+		cubePositions.insert(cubePositions.end(), { v.x, v.y, v.z });
+	std::vector<float> proxyPositions;
+	int volumeDims[3] = { dx, dy, dz };
+	int rayGeometry = -1;
+	float proxyThreshold = 0.0f;
+
+	const float quad[] = { -1, -1, 0, 1, -1, 0, 1, 1, 0, -1, -1, 0, 1, 1, 0, -1, 1, 0 };
+	unsigned int quadVao, quadBuffer;
+	GLCall(glGenVertexArrays(1, &quadVao));
+	GLCall(glBindVertexArray(quadVao));
+	GLCall(glGenBuffers(1, &quadBuffer));
+	GLCall(glBindBuffer(GL_ARRAY_BUFFER, quadBuffer));
+	GLCall(glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW));
+	GLCall(glEnableVertexAttribArray(0));
+	GLCall(glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0));
+	GLCall(glBindVertexArray(vao));
 
 	//-----------------Color_Map----------------------------
 	GLCall(glGenTextures(1, &m_RendererIDn));
@@ -348,11 +435,81 @@ int main(int argc, char* argv[])
 	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
 	GLCall(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 180, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, m_LocalBuffer_color));
 	GLCall(glBindTexture(GL_TEXTURE_2D, 0));
-	GLint viewLoc = glGetUniformLocation(shader, "view");
-	glUniform3iv(volume_dims, 0, volDims);
+	TransferFunction transferFunction;
+	std::unique_ptr<PreIntegrationTable> preIntegration(new PreIntegrationTable());
+	float builtCutoff = -1.0f;
+	int framebufferWidth, framebufferHeight;
+	context->framebufferSize(framebufferWidth, framebufferHeight);
+	int frame = 0;
+	double frameStart = context->time();
+	std::unique_ptr<ProgressiveRenderer> progressiveRenderer(new ProgressiveRenderer());
+	// Frames are timed even without budget=, against the interactive
+	// budget, so that idle accumulation passes are split into strips too;
+	// only budget= scales the interactive frames.
+	bool dynamicScaling = budgetMs > 0.0;
+	std::unique_ptr<DynamicResolution> dynamicResolution(new DynamicResolution(dynamicScaling ? budgetMs : progressiveRenderer->interactiveBudgetMs));
+	glm::mat4 previousModel(0.0f);
+	ShaderProgram* previousShader = nullptr;
+	unsigned long long previousUploads = 0;
+	double lastFrameTime = context->time();
 	do {
+		if (!shadersReported && shaderCompiler->Done()) {
+			int cachedPrograms = 0;
+			for (int program : submittedPrograms)
+				cachedPrograms += shaderCompiler->Get(program)->FromCache() ? 1 : 0;
+			printf("Shaders: %d programs ready after %.1f ms (%s), %d from the binary cache\n", shaderCompiler->ProgramCount(),
+				1000.0 * (context->time() - shadersStart), shaderCompiler->Mode(), cachedPrograms);
+			shadersReported = true;
+		}
+		Compositing compositingMode = preIntegrated ? Compositing::PreIntegrated : compositing == 1 ? Compositing::FrontToBack : Compositing::Legacy;
+		shader = shaderCompiler->Get(renderMode == RenderMode::Composite ? compositePrograms[(int)compositingMode] : raymarchPrograms[(int)renderMode]);
+		bool compiling = shader == nullptr;
+		if (compiling)
+			shader = fallbackProgram.get();
+		shader->Bind();
+		shader->SetUniform3f("volume_dims", (float)dx, (float)dy, (float)dz);
+		shader->SetUniform1i("u_Paged", atlas ? 1 : 0);
+		if (atlas) {
+			const BrickVolumeHeader& header = *brickVolume.header;
+			shader->SetUniform3f("u_BrickGrid", (float)header.bricks[0], (float)header.bricks[1], (float)header.bricks[2]);
+			shader->SetUniform1f("u_BrickSize", (float)header.brickSize);
+			shader->SetUniform1f("u_BrickApron", (float)header.apron);
+			shader->SetUniform1f("u_AtlasSize", (float)atlas->atlasSize());
+		}
+		shader->SetUniform3f("u_CellGrid", (float)cells.dims[0], (float)cells.dims[1], (float)cells.dims[2]);
+		shader->SetUniform1f("u_CellSize", (float)cells.cellSize);
+		shader->SetUniform1f("u_GradientSensitivity", 8.0f);
+		shader->SetUniform1f("u_IsoValue", isoValue);
+		shader->SetUniform1i("u_RefineSteps", 6);
+		lighting.enabled = shading ? 1 : 0;
+		updateLightingBuffer(lightingBuffer, lighting);
+		shader->SetUniformBlockBinding("Lighting", kLightingBinding);
+		// The window runs from its low end to the volume max; everything at or
+		// below the low end is transparent and may be skipped.
+		float thresholdLow = range.min + windowLowShift * (range.max - range.min);
+		float windowLow, windowScale;
+		windowUniforms(volumeTexture, 0.5f * (thresholdLow + range.max), range.max - thresholdLow, windowLow, windowScale);
+		shader->SetUniform1f("u_WindowLow", windowLow);
+		shader->SetUniform1f("u_WindowScale", windowScale);
+		// The isosurface only needs the cells that reach the isovalue.
+		if (renderMode == RenderMode::Isosurface)
+			thresholdLow += isoValue * (range.max - thresholdLow);
+		bool fieldRebuilt = distanceField->update(thresholdLow);
+		if (fieldRebuilt)
+			printf("Distance field: %zu cells in %.2f ms\n", distanceField->lastBuildCells(), distanceField->lastBuildMs());
+		if (++frame % 120 == 0) {
+			double now = context->time();
+			printf("Frame %.2f ms, %s, skipping %s\n", 1000.0 * (now - frameStart) / 120, renderModeName(renderMode), skipModeNames[skipMode]);
+			if (dynamicScaling) {
+				const DynamicResolutionStats& stats = dynamicResolution->stats();
+				printf("Dynamic resolution: scale %.2f, step x%.2f, GPU %.2f ms (average %.2f) of %.1f ms, %llu of %llu frames degraded, %llu refining, %llu over budget\n",
+					dynamicResolution->scale(), dynamicResolution->stepFactor(), stats.lastMs, stats.averageMs, dynamicResolution->budgetMs(),
+					(unsigned long long)stats.degradedFrames, (unsigned long long)stats.frames, (unsigned long long)stats.refinementFrames,
+					(unsigned long long)stats.overBudgetFrames);
+			}
+			frameStart = now;
+		}
 		glMatrixMode(GL_TEXTURE);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 		glm::mat4 trans = glm::translate(model, key_brd);
 		model = glm::scale(glm::mat4(1.0f), vscale);
@@ -360,19 +517,167 @@ int main(int argc, char* argv[])
 		model = glm::rotate(model, angy, glm::vec3(0.0f, 0.8f, 0.0f));
 		model = glm::rotate(model, angz, glm::vec3(0.0f, 0.0f, 0.3f));
 		model = trans * model;
+		if (atlas) {
+			// Bounded number of brick uploads per frame, nearest to the eye
+			// first. Ray setup marches along clip-space +z through model, so
+			// its eye is the centre of the near plane taken back into volume
+			// coordinates. Otherwise rays fan out from the shader's view
+			// uniform, which is never set and stays at the origin.
+			float eye[3] = { 0.0f, 0.0f, 0.0f };
+			if (rayMode != 0) {
+				glm::vec4 camera = glm::inverse(model) * glm::vec4(0.0f, 0.0f, -1.0f, 1.0f);
+				for (int a = 0; a < 3; a++)
+					eye[a] = (camera[a] / camera.w - boxMin[a]) / boxSize[a];
+			}
+			atlas->update(eye, thresholdLow, 32);
+			if (frame % 120 == 0) {
+				const BrickCacheStats& cache = atlas->cache().stats();
+				const BrickAtlasStats& stats = atlas->stats();
+				printf("Bricks: %zu/%zu resident, %llu uploads, %llu evictions; cache %llu hits, %llu misses, %llu evictions\n",
+					stats.resident, stats.wanted, (unsigned long long)stats.uploads, (unsigned long long)stats.evictions,
+					(unsigned long long)cache.hits, (unsigned long long)cache.misses, (unsigned long long)cache.evictions);
+			}
+		}
+
+		// Moving views are drawn at reduced resolution; still ones refine
+		// until converged. Anything else that changes the image restarts it.
+		double now = context->time();
+		double frameMs = 1000.0 * (now - lastFrameTime);
+		lastFrameTime = now;
+		bool moving = compiling || model != previousModel;
+		bool reset = sceneChanged || fieldRebuilt || shader != previousShader;
+		if (atlas) {
+			reset = reset || atlas->stats().uploads != previousUploads;
+			previousUploads = atlas->stats().uploads;
+		}
+		previousModel = model;
+		previousShader = shader;
+		sceneChanged = false;
+		context->framebufferSize(framebufferWidth, framebufferHeight);
+		progressiveRenderer->enabled = progressive;
+		dynamicResolution->update();
+		if (dynamicScaling) {
+			progressiveRenderer->dynamicScale = dynamicResolution->scale();
+			progressiveRenderer->dynamicStepFactor = dynamicResolution->stepFactor();
+		}
+		progressiveRenderer->passBudgetMs = dynamicResolution->targetFraction * dynamicResolution->budgetMs();
+		progressiveRenderer->passCostMs = dynamicResolution->fullQualityMs();
+		if (!progressiveRenderer->beginFrame(framebufferWidth, framebufferHeight, moving, reset, frameMs)) {
+			// Converged: present the accumulated image, and wait for input
+			// rather than spin.
+			progressiveRenderer->endFrame(quadVao, context->framebuffer());
+			GLCall(glBindVertexArray(vao));
+			// Headless, nothing is going to move the view any more.
+			if (context->backend() == GLContextBackend::Headless && frameLimit == 0)
+				break;
+			context->present(0.1);
+			continue;
+		}
+		// Accumulation passes run at full quality and are held to the budget
+		// by their strip size instead.
+		if (progressiveRenderer->interactive())
+			dynamicResolution->beginFrame();
+		else
+			dynamicResolution->beginRefinement(progressiveRenderer->coverage());
+		progressiveRenderer->bindTarget();
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		shader->SetUniform1f("u_FragScale", 1.0f / progressiveRenderer->scale());
+		// Clip space spans 2 units over the window height, so one pixel covers
+		// 2 / height of it, and model scales the volume into clip space. The
+		// vscale steps accumulate in model, so its scale is read back from
+		// the longest axis of its upper 3x3.
+		float modelScale = 0.0f;
+		for (int c = 0; c < 3; c++)
+			modelScale = std::max(modelScale, std::sqrt(model[c][0] * model[c][0] + model[c][1] * model[c][1] + model[c][2] * model[c][2]));
+		modelScale = std::max(modelScale, 1e-6f);
+		shader->SetUniform1f("u_LodFootprint", 2.0f / (progressiveRenderer->scale() * std::max(framebufferHeight, 1) * modelScale));
+		shader->SetUniform1f("u_Jitter", progressiveRenderer->jitter());
 		//-********************************raw_data**********************************************
 		glEnable(GL_TEXTURE_3D);
 		GLCall(glActiveTexture(GL_TEXTURE0));
 		GLCall(glBindTexture(GL_TEXTURE_3D, m_RendererID));
 		//GLCall(glBindTexture(GL_TEXTURE_2D, m_RendererID));
-		GLCall(glUniform1i(u_Text, 0));
+		shader->SetUniform1i("u_Texture", 0);
+		shader->SetUniform1f("u_MaxLod", lodEnabled ? (float)(volumeTexture.levels - 1) : 0.0f);
+		shader->SetUniform1f("u_LodBias", lodBias);
+		shader->SetUniform1i("u_SkipMode", skipMode);
+		shader->SetUniform1f("u_OpacityCutoff", opacityCutoff);
+		if (preIntegrated && builtCutoff != opacityCutoff) {
+			buildTransferFunction(m_LocalBuffer_color, m_Width, opacityCutoff, 256, transferFunction);
+			size_t entries = preIntegration->update(transferFunction);
+			printf("Pre-integration: %zu entries in %.2f ms\n", entries, preIntegration->lastBuildMs());
+			builtCutoff = opacityCutoff;
+		}
+		shader->SetUniform1f("u_PreIntegrationSize", (float)preIntegration->size());
+		GLCall(glActiveTexture(GL_TEXTURE7));
+		GLCall(glBindTexture(GL_TEXTURE_2D, preIntegration->texture()));
+		shader->SetUniform1i("u_PreIntegration", 7);
+		// Bisection restores the hit accuracy of one-voxel steps, so the
+		// isosurface marches with steps twice as long.
+		float passStepScale = stepScale * progressiveRenderer->stepFactor();
+		shader->SetUniform1f("u_StepScale", renderMode == RenderMode::Isosurface ? 2.0f * passStepScale : passStepScale);
+		shader->SetUniform1f("u_MinStepScale", 0.5f * passStepScale);
+		shader->SetUniform1f("u_MaxStepScale", 4.0f * passStepScale);
+		shader->SetUniform1i("u_AdaptiveStep", adaptiveStep ? 1 : 0);
+		// Front-to-back output is premultiplied by its alpha.
+		glBlendFunc(!compiling && (compositing == 1 || preIntegrated) ? GL_ONE : GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		GLCall(glActiveTexture(GL_TEXTURE3));
+		GLCall(glBindTexture(GL_TEXTURE_3D, macroCellTexture));
+		shader->SetUniform1i("u_MacroCells", 3);
+		GLCall(glActiveTexture(GL_TEXTURE4));
+		GLCall(glBindTexture(GL_TEXTURE_3D, distanceField->texture()));
+		shader->SetUniform1i("u_DistanceField", 4);
+		if (volumeTexture.gradientId != 0) {
+			GLCall(glActiveTexture(GL_TEXTURE8));
+			GLCall(glBindTexture(GL_TEXTURE_3D, volumeTexture.gradientId));
+			shader->SetUniform1i("u_Gradients", 8);
+			shader->SetUniform1i("u_GradientNormalized", volumeTexture.gradientFormat == GradientFormat::RGBA8 ? 1 : 0);
+			shader->SetUniform1f("u_GradientMax", volumeTexture.gradientScale);
+		}
+		if (atlas) {
+			GLCall(glActiveTexture(GL_TEXTURE2));
+			GLCall(glBindTexture(GL_TEXTURE_3D, atlas->pageTableTexture()));
+			shader->SetUniform1i("u_PageTable", 2);
+		}
 		//-********************************colormap**********************************************
 		GLCall(glActiveTexture(GL_TEXTURE1));
 		GLCall(glBindTexture(GL_TEXTURE_2D, m_RendererIDn));
-		GLCall(glUniform1i(u_ColorMap, 1));
-		GLint modelLoc = glGetUniformLocation(shader, "model");
-
-		glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
+		shader->SetUniform1i("colormap", 1);
+
+		shader->SetUniform1i("u_RaySetup", rayMode != 0 ? 1 : 0);
+		if (rayMode != 0 && !compiling) {
+			if (rayMode == 2 && (rayGeometry != 2 || proxyThreshold != thresholdLow)) {
+				buildProxyGeometry(cells, volumeDims, thresholdLow, boxMin, boxSize, proxyPositions);
+				raySetup->setGeometry(proxyPositions);
+				proxyThreshold = thresholdLow;
+				printf("Brick proxy: %d triangles\n", raySetup->vertexCount() / 3);
+			}
+			else if (rayMode == 1 && rayGeometry != 1) {
+				raySetup->setGeometry(cubePositions);
+			}
+			rayGeometry = rayMode;
+			raySetup->resize(framebufferWidth, framebufferHeight);
+			raySetup->render(rayProgram->GetRendererID(), glm::value_ptr(model));
+			shader->Bind();
+			progressiveRenderer->bindTarget();
+			GLCall(glActiveTexture(GL_TEXTURE5));
+			GLCall(glBindTexture(GL_TEXTURE_2D, raySetup->entryTexture()));
+			shader->SetUniform1i("u_EntryPoints", 5);
+			GLCall(glActiveTexture(GL_TEXTURE6));
+			GLCall(glBindTexture(GL_TEXTURE_2D, raySetup->exitTexture()));
+			shader->SetUniform1i("u_ExitPoints", 6);
+
+			glm::mat4 identity(1.0f);
+			shader->SetUniformMat4f("model", glm::value_ptr(identity));
+			GLCall(glBindVertexArray(quadVao));
+			GLCall(glDrawArrays(GL_TRIANGLES, 0, 6));
+			progressiveRenderer->endFrame(quadVao, context->framebuffer());
+			dynamicResolution->endFrame();
+			GLCall(glBindVertexArray(vao));
+			context->present();
+			continue;
+		}
+		shader->SetUniformMat4f("model", glm::value_ptr(model));
 		GLCall(glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0));
 		GLCall(glEnableVertexAttribArray(0));
 		glEnableVertexAttribArray(0);
@@ -386,22 +691,54 @@ int main(int argc, char* argv[])
 		//GLCall(glBufferData(GL_ELEMENT_ARRAY_BUFFER, 36 * sizeof(unsigned int), indices, GL_STATIC_DRAW));
 		//GLCall(glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, nullptr));
 		glDrawArrays(GL_TRIANGLES, 0, vertices.size());
-		glfwSwapBuffers(window);
-		glfwPollEvents();
-
-	} while (glfwGetKey(window, GLFW_KEY_ESCAPE) != GLFW_PRESS &&
-		glfwWindowShouldClose(window) == 0);
+		progressiveRenderer->endFrame(quadVao, context->framebuffer());
+		dynamicResolution->endFrame();
+		GLCall(glBindVertexArray(vao));
+		context->present();
+		if (frame == 1)
+			printf("Startup to first frame %.1f ms\n", 1000.0 * (context->time() - startupStart));
+
+	} while (!context->shouldClose() && (frameLimit == 0 || frame < frameLimit));
+
+	if (screenshotPath) {
+		// A window's back buffer is undefined after the swap; blit again.
+		progressiveRenderer->present(context->framebuffer());
+		std::vector<unsigned char> pixels;
+		context->readPixels(pixels);
+		if (writePng(screenshotPath, framebufferWidth, framebufferHeight, pixels.data()))
+			printf("Saved frame %d to %s\n", frame, screenshotPath);
+		else
+			fprintf(stderr, "Could not write %s\n", screenshotPath);
+	}
 
 	glDisable(GL_BLEND);
 	GLCall(glDeleteBuffers(1, &buffer));
 	GLCall(glDeleteVertexArrays(1, &vao));
-	GLCall(glDeleteProgram(shader));
-	glfwTerminate();
+	shaderCompiler.reset();
+	deleteLightingBuffer(lightingBuffer);
+	fallbackProgram.reset();
+	rayProgram.reset();
+	progressiveRenderer.reset();
+	dynamicResolution.reset();
+	GLCall(glDeleteBuffers(1, &quadBuffer));
+	GLCall(glDeleteVertexArrays(1, &quadVao));
+	raySetup.reset();
+	preIntegration.reset();
+	GLCall(glDeleteTextures(1, &macroCellTexture));
+	distanceField.reset();
+	atlas.reset();
+	deleteVolumeTexture(volumeTexture);
+	closeBrickVolume(brickVolume);
+	context.reset();
 	return 0;
 }
 void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods)
 {
 	key_brd = glm::vec3(0.0f, 0.0f, 0.0f);
+	if (action == GLFW_PRESS)
+		sceneChanged = true;
+	if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
+		glfwSetWindowShouldClose(window, GLFW_TRUE);
 	if (key == GLFW_KEY_UP && action == GLFW_PRESS)
 	{
 		key_brd = glm::vec3(0.0f, 0.01f, 0.0f);
@@ -445,6 +782,101 @@ void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods
 	{
 		angz = 0.01f;
 	}
+	else if (key == GLFW_KEY_L && action == GLFW_PRESS)
+	{
+		lodEnabled = !lodEnabled;
+		std::cout << "Level of detail " << (lodEnabled ? "on" : "off") << std::endl;
+	}
+	else if (key == GLFW_KEY_E && action == GLFW_PRESS)
+	{
+		skipMode = (skipMode + 1) % 3;
+		std::cout << "Empty-space skipping " << skipModeNames[skipMode] << std::endl;
+	}
+	else if (key == GLFW_KEY_R && action == GLFW_PRESS)
+	{
+		rayMode = (rayMode + 1) % 3;
+		std::cout << "Ray setup: " << rayModeNames[rayMode] << std::endl;
+	}
+	else if (key == GLFW_KEY_C && action == GLFW_PRESS)
+	{
+		compositing = 1 - compositing;
+		std::cout << "Compositing: " << (compositing == 1 ? "front-to-back" : "additive") << std::endl;
+	}
+	else if (key == GLFW_KEY_A && action == GLFW_PRESS)
+	{
+		adaptiveStep = !adaptiveStep;
+		std::cout << "Adaptive step " << (adaptiveStep ? "on" : "off") << std::endl;
+	}
+	else if (key == GLFW_KEY_COMMA && action == GLFW_PRESS)
+	{
+		stepScale = std::max(stepScale * 0.5f, 0.125f);
+		std::cout << "Step " << stepScale << " voxels" << std::endl;
+	}
+	else if (key == GLFW_KEY_PERIOD && action == GLFW_PRESS)
+	{
+		stepScale = std::min(stepScale * 2.0f, 4.0f);
+		std::cout << "Step " << stepScale << " voxels" << std::endl;
+	}
+	else if (key == GLFW_KEY_I && action == GLFW_PRESS)
+	{
+		preIntegrated = preIntegrationAvailable && !preIntegrated;
+		std::cout << "Pre-integrated transfer function " << (preIntegrated ? "on" : "off") << std::endl;
+	}
+	else if (key == GLFW_KEY_O && action == GLFW_PRESS)
+	{
+		opacityCutoff = std::max(opacityCutoff - 1.0f / 64, 0.0f);
+		std::cout << "Opacity cutoff " << opacityCutoff << std::endl;
+	}
+	else if (key == GLFW_KEY_P && action == GLFW_PRESS)
+	{
+		opacityCutoff = std::min(opacityCutoff + 1.0f / 64, 1.0f);
+		std::cout << "Opacity cutoff " << opacityCutoff << std::endl;
+	}
+	else if (key == GLFW_KEY_PAGE_UP && action == GLFW_PRESS)
+	{
+		windowLowShift = std::min(windowLowShift + 0.02f, 0.98f);
+		std::cout << "Window low end at " << 100.0f * windowLowShift << "% of the range" << std::endl;
+	}
+	else if (key == GLFW_KEY_PAGE_DOWN && action == GLFW_PRESS)
+	{
+		windowLowShift = std::max(windowLowShift - 0.02f, 0.0f);
+		std::cout << "Window low end at " << 100.0f * windowLowShift << "% of the range" << std::endl;
+	}
+	else if (key == GLFW_KEY_G && action == GLFW_PRESS)
+	{
+		progressive = !progressive;
+		std::cout << "Progressive refinement " << (progressive ? "on" : "off") << std::endl;
+	}
+	else if (key == GLFW_KEY_H && action == GLFW_PRESS)
+	{
+		shading = !shading;
+		std::cout << "Phong shading " << (shading ? "on" : "off") << std::endl;
+	}
+	else if (key == GLFW_KEY_M && action == GLFW_PRESS)
+	{
+		renderMode = (RenderMode)(((int)renderMode + 1) % renderModeCount);
+		std::cout << "Render mode: " << renderModeName(renderMode) << std::endl;
+	}
+	else if (key == GLFW_KEY_J && action == GLFW_PRESS)
+	{
+		isoValue = std::max(isoValue - 1.0f / 64, 0.0f);
+		std::cout << "Isovalue " << isoValue << std::endl;
+	}
+	else if (key == GLFW_KEY_K && action == GLFW_PRESS)
+	{
+		isoValue = std::min(isoValue + 1.0f / 64, 1.0f);
+		std::cout << "Isovalue " << isoValue << std::endl;
+	}
+	else if (key == GLFW_KEY_LEFT_BRACKET && action == GLFW_PRESS)
+	{
+		lodBias -= 0.5f;
+		std::cout << "LOD bias " << lodBias << std::endl;
+	}
+	else if (key == GLFW_KEY_RIGHT_BRACKET && action == GLFW_PRESS)
+	{
+		lodBias += 0.5f;
+		std::cout << "LOD bias " << lodBias << std::endl;
+	}
 	else
 	{
 		angx = 0.0f;
@@ -0,0 +1,321 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "batchrender.hpp"
+#include "cpuraycaster.hpp"
+#include "pngwriter.hpp"
+#include "volumereader.hpp"
+#include "vendor/stb_image.h"
+
+namespace {
+
+bool normalize(float v[3])
+{
+	float length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+	if (length < 1e-6f)
+		return false;
+	for (int i = 0; i < 3; i++)
+		v[i] /= length;
+	return true;
+}
+
+void cross(const float a[3], const float b[3], float out[3])
+{
+	out[0] = a[1] * b[2] - a[2] * b[1];
+	out[1] = a[2] * b[0] - a[0] * b[2];
+	out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+// Rotation whose rows are right, up and forward, so that the direction from
+// the eye to the origin becomes +z of clip space, which the rays follow.
+bool lookAt(const float eye[3], const float up[3], float out[16])
+{
+	float forward[3] = { -eye[0], -eye[1], -eye[2] };
+	if (!normalize(forward))
+		return false;
+	float right[3];
+	cross(up, forward, right);
+	if (!normalize(right)) {
+		// Looking along up; any perpendicular will do.
+		const float z[3] = { 0.0f, 0.0f, 1.0f };
+		cross(z, forward, right);
+		normalize(right);
+	}
+	float trueUp[3];
+	cross(forward, right, trueUp);
+	const float* rows[3] = { right, trueUp, forward };
+	for (int c = 0; c < 4; c++)
+		for (int r = 0; r < 4; r++)
+			out[c * 4 + r] = r < 3 && c < 3 ? rows[r][c] : (r == c ? 1.0f : 0.0f);
+	return true;
+}
+
+template <typename T>
+bool loadVolume(const char * path, int dx, int dy, int dz, VoxelLayout layout, CpuVolume & out)
+{
+	VolumeReader<T> reader;
+	if (!reader.open(path, dx, dy, dz))
+		return false;
+	prepareCpuVolume(reader.voxels(), dx, dy, dz, reader.range(), out, layout);
+	return true;
+}
+
+struct EncodeJob
+{
+	size_t view;
+	std::vector<unsigned char>* image;
+};
+
+// Images handed from the renderer to the encoders, and the buffers handed
+// back. Holding one buffer more than there are encoders lets the renderer
+// trace the next view while every encoder is busy, and stalls it only when
+// encoding falls behind.
+class EncodePipeline
+{
+public:
+	EncodePipeline(unsigned int encoders, int width, int height, const std::string & directory)
+		: m_Buffers(encoders + 1), m_Width(width), m_Height(height), m_Directory(directory)
+	{
+		for (auto& buffer : m_Buffers)
+			m_Free.push_back(&buffer);
+		for (unsigned int e = 0; e < encoders; e++)
+			m_Threads.emplace_back(&EncodePipeline::encode, this);
+	}
+
+	~EncodePipeline() { finish(); }
+
+	// Blocks until a buffer is free and returns it.
+	std::vector<unsigned char>* acquire()
+	{
+		std::unique_lock<std::mutex> lock(m_Lock);
+		auto start = std::chrono::steady_clock::now();
+		m_Changed.wait(lock, [this] { return !m_Free.empty(); });
+		m_StallMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		std::vector<unsigned char>* buffer = m_Free.front();
+		m_Free.pop_front();
+		return buffer;
+	}
+
+	void submit(size_t view, std::vector<unsigned char> * image)
+	{
+		{
+			std::lock_guard<std::mutex> guard(m_Lock);
+			m_Jobs.push_back({ view, image });
+		}
+		m_Changed.notify_all();
+	}
+
+	// Writes what is queued and stops the encoders.
+	void finish()
+	{
+		{
+			std::lock_guard<std::mutex> guard(m_Lock);
+			m_Done = true;
+		}
+		m_Changed.notify_all();
+		for (auto& thread : m_Threads)
+			thread.join();
+		m_Threads.clear();
+	}
+
+	double stallMs() const { return m_StallMs; }
+	double encodeMs() const { return m_EncodeMs; }
+	size_t failures() const { return m_Failures; }
+
+private:
+	void encode()
+	{
+		for (;;) {
+			EncodeJob job;
+			{
+				std::unique_lock<std::mutex> lock(m_Lock);
+				m_Changed.wait(lock, [this] { return !m_Jobs.empty() || m_Done; });
+				if (m_Jobs.empty())
+					return;
+				job = m_Jobs.front();
+				m_Jobs.pop_front();
+			}
+			char name[32];
+			snprintf(name, sizeof(name), "/view_%04zu.png", job.view);
+			std::string path = m_Directory + name;
+			auto start = std::chrono::steady_clock::now();
+			bool written = writePng(path.c_str(), m_Width, m_Height, job.image->data());
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			if (!written)
+				fprintf(stderr, "Could not write %s\n", path.c_str());
+			{
+				std::lock_guard<std::mutex> guard(m_Lock);
+				m_EncodeMs += ms;
+				m_Failures += written ? 0 : 1;
+				m_Free.push_back(job.image);
+			}
+			m_Changed.notify_all();
+		}
+	}
+
+	std::deque<std::vector<unsigned char>> m_Buffers;
+	std::deque<std::vector<unsigned char>*> m_Free;
+	std::deque<EncodeJob> m_Jobs;
+	std::vector<std::thread> m_Threads;
+	std::mutex m_Lock;
+	std::condition_variable m_Changed;
+	bool m_Done = false;
+	int m_Width;
+	int m_Height;
+	std::string m_Directory;
+	double m_StallMs = 0.0;
+	double m_EncodeMs = 0.0;
+	size_t m_Failures = 0;
+};
+
+}
+
+bool readViewList(const char * path, std::vector<BatchView> & out_views)
+{
+	std::ifstream file(path);
+	if (!file) {
+		fprintf(stderr, "Could not open view list %s\n", path);
+		return false;
+	}
+	out_views.clear();
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(file, line)) {
+		lineNumber++;
+		size_t comment = line.find('#');
+		if (comment != std::string::npos)
+			line.erase(comment);
+		std::istringstream in(line);
+		std::string kind;
+		if (!(in >> kind))
+			continue;
+		float values[16];
+		int count = 0;
+		while (count < 16 && in >> values[count])
+			count++;
+		BatchView view;
+		if (kind == "model" && count == 16) {
+			memcpy(view.model, values, sizeof(view.model));
+		}
+		else if (kind == "view" && (count == 3 || count == 6)) {
+			float up[3] = { 0.0f, 1.0f, 0.0f };
+			if (count == 6)
+				memcpy(up, values + 3, sizeof(up));
+			if (!lookAt(values, up, view.model)) {
+				fprintf(stderr, "%s:%d: the eye sits at the volume's centre\n", path, lineNumber);
+				return false;
+			}
+		}
+		else {
+			fprintf(stderr, "%s:%d: expected \"model\" and 16 numbers or \"view\" and 3 or 6\n", path, lineNumber);
+			return false;
+		}
+		out_views.push_back(view);
+	}
+	return true;
+}
+
+int runBatch(int argc, char * argv[])
+{
+	VoxelType type;
+	if (argc < 7 || !parseVoxelType(argv[5], type)) {
+		fprintf(stderr, "Usage: %s volume.raw dx dy dz uint8|uint16|int32|float32 batch=views.txt [out=dir] [size=n] [encoders=n] [tile=n] [workers=n] [layout=linear|blocked|morton]\n", argv[0]);
+		return -1;
+	}
+	int dx = atoi(argv[2]);
+	int dy = atoi(argv[3]);
+	int dz = atoi(argv[4]);
+	const char* viewList = nullptr;
+	std::string directory = ".";
+	unsigned int encoders = 1;
+	VoxelLayout layout = VoxelLayout::Linear;
+	CpuRaycastSettings settings;
+	for (int i = 6; i < argc; i++)
+	{
+		const char* flag = argv[i];
+		if (strncmp(flag, "batch=", 6) == 0)
+			viewList = flag + 6;
+		else if (strncmp(flag, "out=", 4) == 0)
+			directory = flag + 4;
+		else if (strncmp(flag, "size=", 5) == 0)
+			settings.width = settings.height = atoi(flag + 5);
+		else if (strncmp(flag, "encoders=", 9) == 0)
+			encoders = (unsigned int)std::max(1, atoi(flag + 9));
+		else if (strncmp(flag, "tile=", 5) == 0)
+			settings.tileSize = atoi(flag + 5);
+		else if (strncmp(flag, "workers=", 8) == 0)
+			settings.workers = (unsigned int)atoi(flag + 8);
+		else if (strncmp(flag, "layout=", 7) == 0) {
+			if (!parseVoxelLayout(flag + 7, layout))
+				fprintf(stderr, "Unknown layout %s, expected linear, blocked or morton\n", flag + 7);
+		}
+		else
+			fprintf(stderr, "Ignoring %s in batch mode\n", flag);
+	}
+	std::vector<BatchView> views;
+	if (!viewList || dx <= 0 || dy <= 0 || dz <= 0 || settings.width <= 0 || !readViewList(viewList, views))
+		return -1;
+
+	CpuVolume volume;
+	bool loaded = false;
+	switch (type)
+	{
+	case VoxelType::UInt8: loaded = loadVolume<unsigned char>(argv[1], dx, dy, dz, layout, volume); break;
+	case VoxelType::UInt16: loaded = loadVolume<unsigned short>(argv[1], dx, dy, dz, layout, volume); break;
+	case VoxelType::Int32: loaded = loadVolume<int>(argv[1], dx, dy, dz, layout, volume); break;
+	case VoxelType::Float32: loaded = loadVolume<float>(argv[1], dx, dy, dz, layout, volume); break;
+	}
+	if (!loaded)
+		return -1;
+
+	int width, height, channels;
+	std::vector<unsigned char> colormap;
+	unsigned char* png = stbi_load("res/textures/matplotlib-virdis.png", &width, &height, &channels, 4);
+	if (png) {
+		colormap.assign(png, png + width * 4);
+		stbi_image_free(png);
+	}
+	else {
+		for (int i = 0; i < 256; i++)
+			colormap.insert(colormap.end(), { (unsigned char)i, (unsigned char)i, (unsigned char)i, 255 });
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	double renderMs = 0.0;
+	size_t failures;
+	double stallMs, encodeMs;
+	{
+		EncodePipeline pipeline(encoders, settings.width, settings.height, directory);
+		for (size_t v = 0; v < views.size(); v++) {
+			std::vector<unsigned char>* image = pipeline.acquire();
+			memcpy(settings.model, views[v].model, sizeof(settings.model));
+			auto renderStart = std::chrono::steady_clock::now();
+			cpuRaycast(volume, colormap.data(), (int)colormap.size() / 4, settings, *image);
+			renderMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - renderStart).count();
+			pipeline.submit(v, image);
+		}
+		pipeline.finish();
+		failures = pipeline.failures();
+		stallMs = pipeline.stallMs();
+		encodeMs = pipeline.encodeMs();
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	size_t count = views.size();
+	printf("%zu views of %dx%d in %.2f s, %.2f views/s (%s)\n", count, settings.width, settings.height, seconds,
+		seconds > 0.0 ? count / seconds : 0.0, cpuRaycastPackets() ? "8-ray AVX2 packets" : "one ray at a time");
+	if (count > 0)
+		printf("Per view: %.2f ms rendering, %.2f ms encoding on %u encoder(s), %.2f ms waiting for a free buffer\n",
+			renderMs / count, encodeMs / count, encoders, stallMs / count);
+	return failures == 0 ? 0 : -1;
+}
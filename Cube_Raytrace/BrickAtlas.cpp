@@ -0,0 +1,205 @@
+#include <stdio.h>
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <utility>
+
+#include "brickatlas.hpp"
+#include "renderer.hpp"
+
+BrickAtlas::BrickAtlas(const BrickVolume & volume, size_t budgetBytes, size_t cacheBricks, bool halfFloat)
+	: m_Volume(volume), m_Cache(volume, cacheBricks)
+{
+	const BrickVolumeHeader& header = *volume.header;
+	m_Format = selectVolumeTextureFormat((VoxelType)header.voxelType, halfFloat);
+	int stored = brickStoredSize(header);
+	size_t slotBytes = (size_t)stored * stored * stored * m_Format.bytesPerTexel;
+
+	// Largest cube of slots inside the budget and the 3D texture limit; the
+	// page table stores slot coordinates in 8 bits. Never more slots than
+	// the volume has bricks.
+	GLint maxSize = 0;
+	GLCall(glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE, &maxSize));
+	int n = (int)std::cbrt((double)budgetBytes / slotBytes);
+	n = std::max(1, std::min(std::min(n, (int)maxSize / stored), 255));
+	while (n > 1 && (size_t)(n - 1) * (n - 1) * (n - 1) >= brickCount(header))
+		n--;
+	m_SlotsPerAxis = n;
+
+	m_Slots.resize((size_t)n * n * n);
+	for (size_t s = 0; s < m_Slots.size(); s++)
+	{
+		m_SlotLru.push_back((int)s);
+		m_Slots[s].lru = std::prev(m_SlotLru.end());
+	}
+	m_BrickSlot.assign(brickCount(header), -1);
+	m_PageEntries.assign(brickCount(header) * 4, 0);
+
+	int size = atlasSize();
+	GLCall(glGenTextures(1, &m_Atlas));
+	GLCall(glBindTexture(GL_TEXTURE_3D, m_Atlas));
+	GLCall(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+	GLCall(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+	GLCall(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE));
+	GLCall(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+	GLCall(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+	GLCall(glTexImage3D(GL_TEXTURE_3D, 0, m_Format.internalFormat, size, size, size, 0, m_Format.format, m_Format.type, nullptr));
+
+	GLCall(glGenTextures(1, &m_PageTable));
+	GLCall(glBindTexture(GL_TEXTURE_3D, m_PageTable));
+	GLCall(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+	GLCall(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+	GLCall(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE));
+	GLCall(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+	GLCall(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+	GLCall(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+	GLCall(glTexImage3D(GL_TEXTURE_3D, 0, GL_RGBA8UI, header.bricks[0], header.bricks[1], header.bricks[2], 0,
+		GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, m_PageEntries.data()));
+	GLCall(glBindTexture(GL_TEXTURE_3D, 0));
+
+	printf("Brick atlas %s %d^3 slots (%d^3 texels): %.1f MB resident, CPU cache %zu bricks\n",
+		m_Format.name, n, size, residentBytes() / (1024.0 * 1024.0), m_Cache.capacity());
+}
+
+BrickAtlas::~BrickAtlas()
+{
+	GLCall(glDeleteTextures(1, &m_Atlas));
+	GLCall(glDeleteTextures(1, &m_PageTable));
+}
+
+size_t BrickAtlas::residentBytes() const
+{
+	size_t size = atlasSize();
+	return size * size * size * m_Format.bytesPerTexel + m_PageEntries.size();
+}
+
+void BrickAtlas::update(const float eye[3], float minVisible, int maxUploads)
+{
+	bool reorder = !m_HaveOrder || !std::equal(eye, eye + 3, m_OrderEye);
+	if (!m_HaveSelection || minVisible != m_SelectedThreshold) {
+		const float roiMin[3] = { 0.0f, 0.0f, 0.0f };
+		const float roiMax[3] = { 1.0f, 1.0f, 1.0f };
+		selectBricks(m_Volume, minVisible, roiMin, roiMax, m_Selected);
+		m_SelectedThreshold = minVisible;
+		m_HaveSelection = true;
+		reorder = true;
+	}
+	// The order only changes with the selection or the eye, so a still view
+	// walks the same wanted list every frame.
+	if (reorder)
+		orderSelected(eye);
+
+	// Touch resident bricks first so the LRU tail only holds bricks this
+	// view does not want (or free slots) when uploads start evicting.
+	for (size_t i = 0; i < m_Wanted; i++)
+	{
+		int slot = m_BrickSlot[m_Order[i].second];
+		if (slot >= 0)
+			m_SlotLru.splice(m_SlotLru.begin(), m_SlotLru, m_Slots[slot].lru);
+	}
+	int uploads = 0;
+	for (size_t i = 0; i < m_Wanted; i++)
+	{
+		int brick = m_Order[i].second;
+		if (m_BrickSlot[brick] >= 0)
+			continue;
+		if (uploads >= maxUploads)
+			break;
+		int slot = m_SlotLru.back();
+		int victim = m_Slots[slot].brick;
+		if (victim >= 0) {
+			m_BrickSlot[victim] = -1;
+			setPageEntry(victim, -1);
+			m_Stats.evictions++;
+		}
+		upload(brick, slot);
+		m_Slots[slot].brick = brick;
+		m_BrickSlot[brick] = slot;
+		m_SlotLru.splice(m_SlotLru.begin(), m_SlotLru, m_Slots[slot].lru);
+		setPageEntry(brick, slot);
+		uploads++;
+	}
+	flushPageTable();
+
+	m_Stats.wanted = m_Wanted;
+	m_Stats.resident = 0;
+	for (const Slot& s : m_Slots)
+		if (s.brick >= 0)
+			m_Stats.resident++;
+}
+
+void BrickAtlas::orderSelected(const float eye[3])
+{
+	const BrickVolumeHeader& header = *m_Volume.header;
+	// Nearest bricks first, as many as there are slots.
+	m_Order.clear();
+	m_Order.reserve(m_Selected.size());
+	for (int index : m_Selected)
+	{
+		int coord[3] = {
+			index % (int)header.bricks[0],
+			(index / (int)header.bricks[0]) % (int)header.bricks[1],
+			index / (int)(header.bricks[0] * header.bricks[1])
+		};
+		float d2 = 0.0f;
+		for (int a = 0; a < 3; a++)
+		{
+			float center = (coord[a] + 0.5f) * header.brickSize / header.dims[a];
+			d2 += (center - eye[a]) * (center - eye[a]);
+		}
+		m_Order.push_back(std::make_pair(d2, index));
+	}
+	m_Wanted = std::min(m_Order.size(), m_Slots.size());
+	std::partial_sort(m_Order.begin(), m_Order.begin() + m_Wanted, m_Order.end());
+	std::copy(eye, eye + 3, m_OrderEye);
+	m_HaveOrder = true;
+}
+
+void BrickAtlas::upload(int brick, int slot)
+{
+	int stored = brickStoredSize(*m_Volume.header);
+	int n = m_SlotsPerAxis;
+	const void* data = m_Cache.fetch(brick);
+	GLCall(glBindTexture(GL_TEXTURE_3D, m_Atlas));
+	GLCall(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+	GLCall(glTexSubImage3D(GL_TEXTURE_3D, 0,
+		(slot % n) * stored, ((slot / n) % n) * stored, (slot / (n * n)) * stored,
+		stored, stored, stored, m_Format.format, m_Format.type, data));
+	GLCall(glBindTexture(GL_TEXTURE_3D, 0));
+	m_Stats.uploads++;
+}
+
+void BrickAtlas::setPageEntry(int brick, int slot)
+{
+	int n = m_SlotsPerAxis;
+	unsigned char* entry = &m_PageEntries[(size_t)brick * 4];
+	entry[0] = slot >= 0 ? (unsigned char)(slot % n) : 0;
+	entry[1] = slot >= 0 ? (unsigned char)((slot / n) % n) : 0;
+	entry[2] = slot >= 0 ? (unsigned char)(slot / (n * n)) : 0;
+	entry[3] = slot >= 0 ? 1 : 0;
+
+	const BrickVolumeHeader& header = *m_Volume.header;
+	int bz = brick / (int)(header.bricks[0] * header.bricks[1]);
+	if (m_DirtyZ[0] > m_DirtyZ[1]) {
+		m_DirtyZ[0] = m_DirtyZ[1] = bz;
+	}
+	else {
+		m_DirtyZ[0] = std::min(m_DirtyZ[0], bz);
+		m_DirtyZ[1] = std::max(m_DirtyZ[1], bz);
+	}
+}
+
+void BrickAtlas::flushPageTable()
+{
+	if (m_DirtyZ[0] > m_DirtyZ[1])
+		return;
+	const BrickVolumeHeader& header = *m_Volume.header;
+	size_t sliceEntries = (size_t)header.bricks[0] * header.bricks[1];
+	GLCall(glBindTexture(GL_TEXTURE_3D, m_PageTable));
+	GLCall(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+	GLCall(glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, m_DirtyZ[0], header.bricks[0], header.bricks[1], m_DirtyZ[1] - m_DirtyZ[0] + 1,
+		GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, &m_PageEntries[m_DirtyZ[0] * sliceEntries * 4]));
+	GLCall(glBindTexture(GL_TEXTURE_3D, 0));
+	m_DirtyZ[0] = 0;
+	m_DirtyZ[1] = -1;
+}
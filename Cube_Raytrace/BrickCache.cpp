@@ -0,0 +1,53 @@
+#include <algorithm>
+#include <cstring>
+
+#include "brickcache.hpp"
+
+BrickCache::BrickCache(const BrickVolume & volume, size_t capacity)
+	: m_Volume(volume), m_Capacity(std::max<size_t>(1, capacity))
+{
+	size_t stored = brickStoredSize(*volume.header);
+	VoxelType type = (VoxelType)volume.header->voxelType;
+	size_t decodedSize = type == VoxelType::Int32 ? sizeof(float) : voxelSize(type);
+	m_DecodedBytes = stored * stored * stored * decodedSize;
+}
+
+const void* BrickCache::fetch(int index)
+{
+	auto it = m_Entries.find(index);
+	if (it != m_Entries.end()) {
+		m_Stats.hits++;
+		m_Lru.splice(m_Lru.begin(), m_Lru, it->second.lru);
+		return it->second.data.data();
+	}
+
+	m_Stats.misses++;
+	std::vector<unsigned char> data;
+	if (m_Entries.size() >= m_Capacity) {
+		// Recycle the least recently used brick's buffer.
+		int victim = m_Lru.back();
+		m_Lru.pop_back();
+		data.swap(m_Entries[victim].data);
+		m_Entries.erase(victim);
+		m_Stats.evictions++;
+	}
+	data.resize(m_DecodedBytes);
+
+	const void* src = brickData(m_Volume, index);
+	if ((VoxelType)m_Volume.header->voxelType == VoxelType::Int32) {
+		const int* voxels = (const int*)src;
+		float* out = (float*)data.data();
+		size_t count = m_DecodedBytes / sizeof(float);
+		for (size_t i = 0; i < count; i++)
+			out[i] = (float)voxels[i];
+	}
+	else {
+		memcpy(data.data(), src, m_DecodedBytes);
+	}
+
+	m_Lru.push_front(index);
+	Entry& entry = m_Entries[index];
+	entry.lru = m_Lru.begin();
+	entry.data.swap(data);
+	return entry.data.data();
+}
@@ -0,0 +1,317 @@
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+#include "brickvolume.hpp"
+#include "morton.hpp"
+#include "parallel.hpp"
+
+// Bricked volume conversion and access.
+// Brick payloads have a fixed stride, so every brick's offset is known
+// before any is built; each worker fills its own contiguous run of the
+// Z-order with positioned writes through its own FILE handle.
+
+static uint64_t alignUp(uint64_t v, uint64_t a)
+{
+	return (v + a - 1) / a * a;
+}
+
+static bool seekFile(FILE * file, uint64_t offset)
+{
+#ifdef _WIN32
+	return _fseeki64(file, (__int64)offset, SEEK_SET) == 0;
+#else
+	return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+size_t brickCount(const BrickVolumeHeader & header)
+{
+	return (size_t)header.bricks[0] * header.bricks[1] * header.bricks[2];
+}
+
+int brickIndex(const BrickVolumeHeader & header, int bx, int by, int bz)
+{
+	return bx + header.bricks[0] * (by + header.bricks[1] * bz);
+}
+
+int brickStoredSize(const BrickVolumeHeader & header)
+{
+	return header.brickSize + 2 * header.apron;
+}
+
+size_t brickBytes(const BrickVolumeHeader & header)
+{
+	size_t n = brickStoredSize(header);
+	return n * n * n * voxelSize((VoxelType)header.voxelType);
+}
+
+// Copies one brick plus apron out of the linear volume, clamping at the
+// edges, and records its statistics.
+template <typename T>
+static void extractBrick(
+	const T * voxels,
+	const int dims[3],
+	const int brick[3],
+	int brickSize,
+	int apron,
+	T * out,
+	BrickInfo & info
+) {
+	int stored = brickSize + 2 * apron;
+	int origin[3];
+	for (int a = 0; a < 3; a++)
+		origin[a] = brick[a] * brickSize - apron;
+
+	T lo = voxels[0], hi = voxels[0];
+	bool first = true;
+	double sum = 0.0;
+	size_t interior = 0;
+	for (int z = 0; z < stored; z++)
+	{
+		int vz = origin[2] + z;
+		int sz = std::min(std::max(vz, 0), dims[2] - 1);
+		for (int y = 0; y < stored; y++)
+		{
+			int vy = origin[1] + y;
+			int sy = std::min(std::max(vy, 0), dims[1] - 1);
+			const T* row = voxels + ((size_t)sz * dims[1] + sy) * dims[0];
+			T* dst = out + ((size_t)z * stored + y) * stored;
+			bool rowInterior = z >= apron && z < apron + brickSize && vz < dims[2]
+				&& y >= apron && y < apron + brickSize && vy < dims[1];
+			for (int x = 0; x < stored; x++)
+			{
+				int vx = origin[0] + x;
+				T v = row[std::min(std::max(vx, 0), dims[0] - 1)];
+				dst[x] = v;
+				if (first) {
+					lo = hi = v;
+					first = false;
+				}
+				lo = std::min(lo, v);
+				hi = std::max(hi, v);
+				if (rowInterior && x >= apron && x < apron + brickSize && vx < dims[0]) {
+					sum += v;
+					interior++;
+				}
+			}
+		}
+	}
+	info.min = (float)lo;
+	info.max = (float)hi;
+	info.mean = interior ? (float)(sum / interior) : 0.0f;
+}
+
+template <typename T>
+static bool convertToBricksAs(
+	const char * rawPath,
+	int dx, int dy, int dz,
+	const char * outPath,
+	int brickSize,
+	int apron
+) {
+	VolumeReader<T> reader;
+	if (!reader.open(rawPath, dx, dy, dz))
+		return false;
+
+	BrickVolumeHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, kBrickMagic, sizeof(header.magic));
+	header.version = kBrickVersion;
+	header.dims[0] = dx;
+	header.dims[1] = dy;
+	header.dims[2] = dz;
+	header.voxelType = (uint32_t)VoxelTraits<T>::type;
+	header.brickSize = brickSize;
+	header.apron = apron;
+	for (int a = 0; a < 3; a++)
+		header.bricks[a] = (header.dims[a] + brickSize - 1) / brickSize;
+	size_t count = brickCount(header);
+	header.brickTableOffset = sizeof(BrickVolumeHeader);
+	header.dataOffset = alignUp(header.brickTableOffset + count * sizeof(BrickInfo), kBrickAlignment);
+	uint64_t stride = alignUp(brickBytes(header), kBrickAlignment);
+
+	// Z-order of the brick grid; grids need not be powers of two, so sort
+	// the linear indices by their Morton code.
+	std::vector<int> order(count);
+	for (size_t i = 0; i < count; i++)
+		order[i] = (int)i;
+	std::vector<uint64_t> codes(count);
+	for (uint32_t bz = 0; bz < header.bricks[2]; bz++)
+		for (uint32_t by = 0; by < header.bricks[1]; by++)
+			for (uint32_t bx = 0; bx < header.bricks[0]; bx++)
+				codes[brickIndex(header, bx, by, bz)] = mortonEncode3(bx, by, bz);
+	std::sort(order.begin(), order.end(), [&](int a, int b) { return codes[a] < codes[b]; });
+
+	std::vector<BrickInfo> table(count);
+	for (size_t rank = 0; rank < count; rank++)
+	{
+		table[order[rank]].zorder = (uint32_t)rank;
+		table[order[rank]].offset = header.dataOffset + rank * stride;
+	}
+
+	FILE* out = fopen(outPath, "wb");
+	if (out == NULL) {
+		printf("Impossible to create %s\n", outPath);
+		return false;
+	}
+	fclose(out);
+
+	std::atomic<bool> ok(true);
+	parallelFor(0, count, 1, [&](size_t b, size_t e, size_t) {
+		FILE* file = fopen(outPath, "r+b");
+		if (file == NULL) {
+			ok = false;
+			return;
+		}
+		int stored = brickStoredSize(header);
+		std::vector<T> brick((size_t)stored * stored * stored);
+		for (size_t rank = b; rank < e && ok; rank++)
+		{
+			int index = order[rank];
+			int coord[3] = {
+				index % (int)header.bricks[0],
+				(index / (int)header.bricks[0]) % (int)header.bricks[1],
+				index / (int)(header.bricks[0] * header.bricks[1])
+			};
+			extractBrick(reader.voxels(), reader.dims(), coord, brickSize, apron, brick.data(), table[index]);
+			if (!seekFile(file, table[index].offset) || fwrite(brick.data(), sizeof(T), brick.size(), file) != brick.size())
+				ok = false;
+		}
+		fclose(file);
+	});
+
+	out = fopen(outPath, "r+b");
+	if (out == NULL || !ok) {
+		printf("Failed to write %s\n", outPath);
+		if (out != NULL)
+			fclose(out);
+		return false;
+	}
+	fwrite(&header, sizeof(header), 1, out);
+	fwrite(table.data(), sizeof(BrickInfo), count, out);
+	fclose(out);
+	printf("Wrote %s: %ux%ux%u bricks of %d^3 %s\n", outPath,
+		header.bricks[0], header.bricks[1], header.bricks[2], brickSize, voxelTypeName(VoxelTraits<T>::type));
+	return true;
+}
+
+bool convertToBricks(
+	const char * rawPath,
+	int dx, int dy, int dz,
+	VoxelType type,
+	const char * outPath,
+	int brickSize,
+	int apron
+) {
+	if (brickSize <= 0 || apron < 0 || apron >= brickSize) {
+		printf("Invalid brick size %d (apron %d)\n", brickSize, apron);
+		return false;
+	}
+	if (dx <= 0 || dy <= 0 || dz <= 0) {
+		printf("Invalid volume size %dx%dx%d\n", dx, dy, dz);
+		return false;
+	}
+	switch (type) {
+	case VoxelType::UInt8: return convertToBricksAs<unsigned char>(rawPath, dx, dy, dz, outPath, brickSize, apron);
+	case VoxelType::UInt16: return convertToBricksAs<unsigned short>(rawPath, dx, dy, dz, outPath, brickSize, apron);
+	case VoxelType::Int32: return convertToBricksAs<int>(rawPath, dx, dy, dz, outPath, brickSize, apron);
+	case VoxelType::Float32: return convertToBricksAs<float>(rawPath, dx, dy, dz, outPath, brickSize, apron);
+	}
+	return false;
+}
+
+bool openBrickVolume(const char * path, BrickVolume & out_volume)
+{
+	out_volume = BrickVolume();
+	VolumeSource source;
+	if (!mapVolume(path, source, VolumeAccess::Random))
+		return false;
+
+	const BrickVolumeHeader* header = volumeData<BrickVolumeHeader>(source);
+	bool valid = volumeCount<BrickVolumeHeader>(source) >= 1
+		&& memcmp(header->magic, kBrickMagic, sizeof(header->magic)) == 0
+		&& header->version == kBrickVersion
+		&& header->brickSize > 0
+		&& header->apron < header->brickSize
+		// Keeps brickStoredSize and brickBytes from overflowing.
+		&& header->brickSize <= (1u << 16)
+		&& header->voxelType <= (uint32_t)VoxelType::Float32;
+	// Every axis holds at least one brick, and as many as the dims need;
+	// brickVolumeRange and the brick lookups rely on both.
+	for (int a = 0; valid && a < 3; a++)
+		valid = header->dims[a] > 0
+			&& header->bricks[a] == ((uint64_t)header->dims[a] + header->brickSize - 1) / header->brickSize;
+	if (valid) {
+		size_t count = brickCount(*header);
+		valid = volumeCount<BrickInfo>(source, (size_t)header->brickTableOffset) >= count;
+		const BrickInfo* table = volumeData<BrickInfo>(source, (size_t)header->brickTableOffset);
+		// Written so that a crafted offset cannot wrap around the test.
+		size_t bytes = brickBytes(*header);
+		for (size_t i = 0; valid && i < count; i++)
+			valid = table[i].offset <= source.size && bytes <= source.size - table[i].offset;
+	}
+	if (!valid) {
+		printf("%s is not a valid brick volume\n", path);
+		unmapVolume(source);
+		return false;
+	}
+	out_volume.source = source;
+	out_volume.header = header;
+	out_volume.table = volumeData<BrickInfo>(source, (size_t)header->brickTableOffset);
+	return true;
+}
+
+void closeBrickVolume(BrickVolume & volume)
+{
+	unmapVolume(volume.source);
+	volume = BrickVolume();
+}
+
+const void* brickData(const BrickVolume & volume, int index)
+{
+	return volume.source.data + volume.table[index].offset;
+}
+
+VolumeRange brickVolumeRange(const BrickVolume & volume)
+{
+	VolumeRange range = { volume.table[0].min, volume.table[0].max };
+	size_t count = brickCount(*volume.header);
+	for (size_t i = 1; i < count; i++)
+	{
+		range.min = std::min(range.min, volume.table[i].min);
+		range.max = std::max(range.max, volume.table[i].max);
+	}
+	return range;
+}
+
+void selectBricks(
+	const BrickVolume & volume,
+	float minVisible,
+	const float roiMin[3],
+	const float roiMax[3],
+	std::vector<int> & out_bricks
+) {
+	const BrickVolumeHeader& header = *volume.header;
+	int lo[3], hi[3];
+	for (int a = 0; a < 3; a++)
+	{
+		float scale = (float)header.dims[a] / header.brickSize;
+		lo[a] = std::max(0, (int)(roiMin[a] * scale));
+		hi[a] = std::min((int)header.bricks[a] - 1, (int)(roiMax[a] * scale));
+	}
+	out_bricks.clear();
+	for (int bz = lo[2]; bz <= hi[2]; bz++)
+		for (int by = lo[1]; by <= hi[1]; by++)
+			for (int bx = lo[0]; bx <= hi[0]; bx++)
+			{
+				int index = brickIndex(header, bx, by, bz);
+				if (volume.table[index].max > minVisible)
+					out_bricks.push_back(index);
+			}
+	std::sort(out_bricks.begin(), out_bricks.end(), [&](int a, int b) {
+		return volume.table[a].zorder < volume.table[b].zorder;
+	});
+}
@@ -0,0 +1,436 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#define CPURAYCASTER_AVX2
+#endif
+
+#include "cpuraycaster.hpp"
+
+template <typename T>
+void prepareCpuVolume(const T * voxels, int dx, int dy, int dz, VolumeRange window, CpuVolume & out, VoxelLayout layout)
+{
+	out.dims[0] = dx;
+	out.dims[1] = dy;
+	out.dims[2] = dz;
+	out.grid = makeVoxelGrid(layout, dx + 2, dy + 2, dz + 2);
+	float scale = window.max > window.min ? 1.0f / (window.max - window.min) : 0.0f;
+	float border = (0.0f - window.min) * scale;
+	out.values.assign(out.grid.size, border);
+	swizzleVolume(voxels, dx, dy, dz, out.grid, 1, 1, 1, out.values.data(),
+		[=](T v) { return ((float)v - window.min) * scale; });
+}
+
+template void prepareCpuVolume<unsigned char>(const unsigned char*, int, int, int, VolumeRange, CpuVolume&, VoxelLayout);
+template void prepareCpuVolume<unsigned short>(const unsigned short*, int, int, int, VolumeRange, CpuVolume&, VoxelLayout);
+template void prepareCpuVolume<int>(const int*, int, int, int, VolumeRange, CpuVolume&, VoxelLayout);
+template void prepareCpuVolume<float>(const float*, int, int, int, VolumeRange, CpuVolume&, VoxelLayout);
+
+bool cpuRaycastPackets()
+{
+#ifdef CPURAYCASTER_AVX2
+	return true;
+#else
+	return false;
+#endif
+}
+
+namespace {
+
+// Column-major 4x4 inverse by cofactors; false when singular.
+bool invert(const float m[16], float out[16])
+{
+	float inv[16];
+	inv[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+	inv[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+	inv[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+	inv[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+	inv[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+	inv[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+	inv[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+	inv[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+	inv[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+	inv[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+	inv[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+	inv[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+	inv[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+	inv[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+	inv[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11] - m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+	inv[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10] + m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+	float det = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+	if (det == 0.0f)
+		return false;
+	for (int i = 0; i < 16; i++)
+		out[i] = inv[i] / det;
+	return true;
+}
+
+// Everything a ray needs that does not change from pixel to pixel.
+struct Scene
+{
+	const float* values;
+	int dims[3];
+	VoxelGrid grid;
+	float clip[16];
+	float boxMin[3];
+	float invBoxSize[3];
+	float colormap[3][256];
+	int colormapSize;
+	float stepScale;
+	int compositing;
+	float opacityCutoff;
+	float ndcScale[2];
+};
+
+const float kOpaque = 0.95f;
+
+inline float lerp(float a, float b, float f)
+{
+	return a + (b - a) * f;
+}
+
+// Trilinear like GL_LINEAR: texel centers at (i + 0.5) / dims.
+template <VoxelLayout L>
+float sampleScalar(const Scene & scene, const float p[3])
+{
+	int index[3];
+	float f[3];
+	for (int a = 0; a < 3; a++) {
+		float c = p[a] * scene.dims[a] - 0.5f;
+		float fl = std::floor(c);
+		f[a] = c - fl;
+		index[a] = std::min(std::max((int)fl + 1, 0), scene.dims[a]);
+	}
+	return trilinear<L>(scene.values, scene.grid, index[0], index[1], index[2], f[0], f[1], f[2]);
+}
+
+// Volume-space ray of a pixel: origin on the near plane, unit direction
+// and the [t0, t1] inside the box; t0 > t1 when it misses.
+void setupScalar(const Scene & scene, float ndcX, float ndcY, float origin[3], float dir[3], float& t0, float& t1)
+{
+	const float* m = scene.clip;
+	float nearW = m[3] * ndcX + m[7] * ndcY - m[11] + m[15];
+	float farW = m[3] * ndcX + m[7] * ndcY + m[11] + m[15];
+	float length = 0.0f;
+	for (int a = 0; a < 3; a++) {
+		float nearP = (m[a] * ndcX + m[4 + a] * ndcY - m[8 + a] + m[12 + a]) / nearW;
+		float farP = (m[a] * ndcX + m[4 + a] * ndcY + m[8 + a] + m[12 + a]) / farW;
+		origin[a] = (nearP - scene.boxMin[a]) * scene.invBoxSize[a];
+		dir[a] = (farP - scene.boxMin[a]) * scene.invBoxSize[a] - origin[a];
+		length += dir[a] * dir[a];
+	}
+	length = std::sqrt(length);
+	t0 = 0.0f;
+	t1 = length;
+	for (int a = 0; a < 3; a++) {
+		dir[a] /= length;
+		float invDir = 1.0f / dir[a];
+		float tA = (0.0f - origin[a]) * invDir;
+		float tB = (1.0f - origin[a]) * invDir;
+		t0 = std::max(t0, std::min(tA, tB));
+		t1 = std::min(t1, std::max(tA, tB));
+	}
+}
+
+float dtVoxel(const Scene & scene, const float dir[3])
+{
+	float dt = 1e30f;
+	for (int a = 0; a < 3; a++)
+		dt = std::min(dt, 1.0f / (scene.dims[a] * std::fabs(dir[a])));
+	return dt;
+}
+
+void colormapScalar(const Scene & scene, float val, float rgb[3])
+{
+	float u = val * scene.colormapSize - 0.5f;
+	float fl = std::floor(u);
+	float f = u - fl;
+	int i0 = std::min(std::max((int)fl, 0), scene.colormapSize - 1);
+	int i1 = std::min(std::max((int)fl + 1, 0), scene.colormapSize - 1);
+	for (int c = 0; c < 3; c++)
+		rgb[c] = lerp(scene.colormap[c][i0], scene.colormap[c][i1], f);
+}
+
+template <VoxelLayout L>
+void traceScalar(const Scene & scene, float ndcX, float ndcY, float out[4])
+{
+	float origin[3], dir[3], t0, t1;
+	setupScalar(scene, ndcX, ndcY, origin, dir, t0, t1);
+	out[0] = out[1] = out[2] = out[3] = 0.0f;
+	if (!(t0 <= t1))
+		return;
+	float dt = scene.stepScale * dtVoxel(scene, dir);
+	for (float t = t0; t <= t1; t += dt) {
+		float p[3] = { origin[0] + dir[0] * t, origin[1] + dir[1] * t, origin[2] + dir[2] * t };
+		float val = std::min(std::max(sampleScalar<L>(scene, p), 0.0f), 1.0f);
+		float rgb[3];
+		colormapScalar(scene, val, rgb);
+		float opacity = val >= scene.opacityCutoff ? val : 0.0f;
+		if (scene.compositing == 1) {
+			float alpha = scene.stepScale == 1.0f ? opacity : 1.0f - std::pow(1.0f - opacity, scene.stepScale);
+			float weight = (1.0f - out[3]) * alpha;
+			for (int c = 0; c < 3; c++)
+				out[c] += weight * rgb[c];
+			out[3] += weight;
+		}
+		else {
+			for (int c = 0; c < 3; c++)
+				out[c] += rgb[c];
+			out[3] += opacity;
+		}
+		if (out[3] >= kOpaque)
+			break;
+	}
+}
+
+#ifdef CPURAYCASTER_AVX2
+inline __m256 lerp8(__m256 a, __m256 b, __m256 f)
+{
+	return _mm256_fmadd_ps(_mm256_sub_ps(b, a), f, a);
+}
+
+inline __m256 clamp8(__m256 v, float lo, float hi)
+{
+	return _mm256_min_ps(_mm256_max_ps(v, _mm256_set1_ps(lo)), _mm256_set1_ps(hi));
+}
+
+// Per-lane axisOffset; Morton codes only up to 10 bits per axis.
+template <VoxelLayout L>
+inline __m256i axisOffset8(const VoxelGrid & grid, __m256i v, int axis)
+{
+	if (L == VoxelLayout::Morton) {
+		v = _mm256_and_si256(_mm256_or_si256(v, _mm256_slli_epi32(v, 16)), _mm256_set1_epi32(0x030000ff));
+		v = _mm256_and_si256(_mm256_or_si256(v, _mm256_slli_epi32(v, 8)), _mm256_set1_epi32(0x0300f00f));
+		v = _mm256_and_si256(_mm256_or_si256(v, _mm256_slli_epi32(v, 4)), _mm256_set1_epi32(0x030c30c3));
+		v = _mm256_and_si256(_mm256_or_si256(v, _mm256_slli_epi32(v, 2)), _mm256_set1_epi32(0x09249249));
+		return _mm256_sll_epi32(v, _mm_cvtsi32_si128(axis));
+	}
+	__m256i stride = _mm256_set1_epi32((int)grid.stride[axis]);
+	if (L == VoxelLayout::Blocked)
+		return _mm256_add_epi32(_mm256_mullo_epi32(_mm256_srli_epi32(v, 2), stride),
+			_mm256_sll_epi32(_mm256_and_si256(v, _mm256_set1_epi32(3)), _mm_cvtsi32_si128(2 * axis)));
+	return _mm256_mullo_epi32(v, stride);
+}
+
+template <VoxelLayout L>
+__m256 sample8(const Scene & scene, const __m256 p[3])
+{
+	__m256i index[3];
+	__m256 f[3];
+	for (int a = 0; a < 3; a++) {
+		__m256 c = _mm256_fmsub_ps(p[a], _mm256_set1_ps((float)scene.dims[a]), _mm256_set1_ps(0.5f));
+		__m256 fl = _mm256_floor_ps(c);
+		f[a] = _mm256_sub_ps(c, fl);
+		__m256i i = _mm256_add_epi32(_mm256_cvttps_epi32(fl), _mm256_set1_epi32(1));
+		index[a] = _mm256_min_epi32(_mm256_max_epi32(i, _mm256_setzero_si256()), _mm256_set1_epi32(scene.dims[a]));
+	}
+	__m256i one = _mm256_set1_epi32(1);
+	__m256i x0 = axisOffset8<L>(scene.grid, index[0], 0);
+	__m256i x1 = axisOffset8<L>(scene.grid, _mm256_add_epi32(index[0], one), 0);
+	__m256i y0 = axisOffset8<L>(scene.grid, index[1], 1);
+	__m256i y1 = axisOffset8<L>(scene.grid, _mm256_add_epi32(index[1], one), 1);
+	__m256i z0 = axisOffset8<L>(scene.grid, index[2], 2);
+	__m256i z1 = axisOffset8<L>(scene.grid, _mm256_add_epi32(index[2], one), 2);
+	__m256i i00 = _mm256_add_epi32(y0, z0);
+	__m256i i10 = _mm256_add_epi32(y1, z0);
+	__m256i i01 = _mm256_add_epi32(y0, z1);
+	__m256i i11 = _mm256_add_epi32(y1, z1);
+	const float* v = scene.values;
+	__m256 x00 = lerp8(_mm256_i32gather_ps(v, _mm256_add_epi32(i00, x0), 4), _mm256_i32gather_ps(v, _mm256_add_epi32(i00, x1), 4), f[0]);
+	__m256 x10 = lerp8(_mm256_i32gather_ps(v, _mm256_add_epi32(i10, x0), 4), _mm256_i32gather_ps(v, _mm256_add_epi32(i10, x1), 4), f[0]);
+	__m256 x01 = lerp8(_mm256_i32gather_ps(v, _mm256_add_epi32(i01, x0), 4), _mm256_i32gather_ps(v, _mm256_add_epi32(i01, x1), 4), f[0]);
+	__m256 x11 = lerp8(_mm256_i32gather_ps(v, _mm256_add_epi32(i11, x0), 4), _mm256_i32gather_ps(v, _mm256_add_epi32(i11, x1), 4), f[0]);
+	return lerp8(lerp8(x00, x10, f[1]), lerp8(x01, x11, f[1]), f[2]);
+}
+
+void colormap8(const Scene & scene, __m256 val, __m256 rgb[3])
+{
+	__m256 u = _mm256_fmsub_ps(val, _mm256_set1_ps((float)scene.colormapSize), _mm256_set1_ps(0.5f));
+	__m256 fl = _mm256_floor_ps(u);
+	__m256 f = _mm256_sub_ps(u, fl);
+	__m256i i = _mm256_cvttps_epi32(fl);
+	__m256i last = _mm256_set1_epi32(scene.colormapSize - 1);
+	__m256i i0 = _mm256_min_epi32(_mm256_max_epi32(i, _mm256_setzero_si256()), last);
+	__m256i i1 = _mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(i, _mm256_set1_epi32(1)), _mm256_setzero_si256()), last);
+	for (int c = 0; c < 3; c++)
+		rgb[c] = lerp8(_mm256_i32gather_ps(scene.colormap[c], i0, 4), _mm256_i32gather_ps(scene.colormap[c], i1, 4), f);
+}
+
+// Eight horizontally adjacent pixels; lanes past the row end are idle.
+template <VoxelLayout L>
+void tracePacket(const Scene & scene, int x, int lanes, float ndcY, float out[4][8])
+{
+	const float* m = scene.clip;
+	__m256 ndcX = _mm256_fmsub_ps(
+		_mm256_add_ps(_mm256_set1_ps(x + 0.5f), _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7)),
+		_mm256_set1_ps(scene.ndcScale[0]), _mm256_set1_ps(1.0f));
+	auto row = [&](int a, float zSign) {
+		return _mm256_fmadd_ps(_mm256_set1_ps(m[a]), ndcX, _mm256_set1_ps(m[4 + a] * ndcY + zSign * m[8 + a] + m[12 + a]));
+	};
+	__m256 nearW = row(3, -1.0f);
+	__m256 farW = row(3, 1.0f);
+	__m256 origin[3], dir[3];
+	__m256 length = _mm256_setzero_ps();
+	for (int a = 0; a < 3; a++) {
+		__m256 nearP = _mm256_div_ps(row(a, -1.0f), nearW);
+		__m256 farP = _mm256_div_ps(row(a, 1.0f), farW);
+		__m256 boxMin = _mm256_set1_ps(scene.boxMin[a]);
+		__m256 invSize = _mm256_set1_ps(scene.invBoxSize[a]);
+		origin[a] = _mm256_mul_ps(_mm256_sub_ps(nearP, boxMin), invSize);
+		dir[a] = _mm256_sub_ps(_mm256_mul_ps(_mm256_sub_ps(farP, boxMin), invSize), origin[a]);
+		length = _mm256_fmadd_ps(dir[a], dir[a], length);
+	}
+	length = _mm256_sqrt_ps(length);
+	// Slab test against [0, 1]^3, all eight rays at once.
+	__m256 t0 = _mm256_setzero_ps();
+	__m256 t1 = length;
+	__m256 dtVoxel = _mm256_set1_ps(1e30f);
+	__m256 signMask = _mm256_set1_ps(-0.0f);
+	for (int a = 0; a < 3; a++) {
+		dir[a] = _mm256_div_ps(dir[a], length);
+		__m256 invDir = _mm256_div_ps(_mm256_set1_ps(1.0f), dir[a]);
+		__m256 tA = _mm256_mul_ps(_mm256_sub_ps(_mm256_setzero_ps(), origin[a]), invDir);
+		__m256 tB = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f), origin[a]), invDir);
+		t0 = _mm256_max_ps(t0, _mm256_min_ps(tA, tB));
+		t1 = _mm256_min_ps(t1, _mm256_max_ps(tA, tB));
+		__m256 axis = _mm256_div_ps(_mm256_set1_ps(1.0f),
+			_mm256_mul_ps(_mm256_set1_ps((float)scene.dims[a]), _mm256_andnot_ps(signMask, dir[a])));
+		dtVoxel = _mm256_min_ps(dtVoxel, axis);
+	}
+	__m256 dt = _mm256_mul_ps(_mm256_set1_ps(scene.stepScale), dtVoxel);
+	__m256 valid = _mm256_cmp_ps(_mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_ps((float)lanes), _CMP_LT_OQ);
+
+	__m256 color[4] = { _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps() };
+	__m256 t = t0;
+	__m256 active = _mm256_and_ps(valid, _mm256_cmp_ps(t, t1, _CMP_LE_OQ));
+	__m256 cutoff = _mm256_set1_ps(scene.opacityCutoff);
+	__m256 ones = _mm256_set1_ps(1.0f);
+	while (_mm256_movemask_ps(active) != 0) {
+		__m256 p[3];
+		for (int a = 0; a < 3; a++)
+			p[a] = _mm256_fmadd_ps(dir[a], t, origin[a]);
+		// Idle lanes sample the volume origin rather than wherever they are.
+		for (int a = 0; a < 3; a++)
+			p[a] = _mm256_and_ps(active, p[a]);
+		__m256 val = clamp8(sample8<L>(scene, p), 0.0f, 1.0f);
+		__m256 rgb[3];
+		colormap8(scene, val, rgb);
+		__m256 opacity = _mm256_and_ps(_mm256_cmp_ps(val, cutoff, _CMP_GE_OQ), val);
+		if (scene.compositing == 1) {
+			__m256 alpha = opacity;
+			if (scene.stepScale != 1.0f) {
+				alignas(32) float lane[8];
+				_mm256_store_ps(lane, opacity);
+				for (int i = 0; i < 8; i++)
+					lane[i] = 1.0f - std::pow(1.0f - lane[i], scene.stepScale);
+				alpha = _mm256_load_ps(lane);
+			}
+			__m256 weight = _mm256_and_ps(active, _mm256_mul_ps(_mm256_sub_ps(ones, color[3]), alpha));
+			for (int c = 0; c < 3; c++)
+				color[c] = _mm256_fmadd_ps(weight, rgb[c], color[c]);
+			color[3] = _mm256_add_ps(color[3], weight);
+		}
+		else {
+			for (int c = 0; c < 3; c++)
+				color[c] = _mm256_add_ps(color[c], _mm256_and_ps(active, rgb[c]));
+			color[3] = _mm256_add_ps(color[3], _mm256_and_ps(active, opacity));
+		}
+		t = _mm256_add_ps(t, dt);
+		active = _mm256_and_ps(active, _mm256_and_ps(
+			_mm256_cmp_ps(color[3], _mm256_set1_ps(kOpaque), _CMP_LT_OQ),
+			_mm256_cmp_ps(t, t1, _CMP_LE_OQ)));
+	}
+	for (int c = 0; c < 4; c++)
+		_mm256_storeu_ps(out[c], color[c]);
+}
+#endif
+
+inline unsigned char toUnorm8(float v)
+{
+	return (unsigned char)(std::min(std::max(v, 0.0f), 1.0f) * 255.0f + 0.5f);
+}
+
+}
+
+template <VoxelLayout L>
+static void renderTiles(const Scene & scene, int width, int height, bool packets, const CpuRaycastSettings & settings, unsigned char * image, TileStats * out_stats)
+{
+#ifndef CPURAYCASTER_AVX2
+	// Without AVX2 every pixel is traced on its own; packets is always false.
+	(void)packets;
+#endif
+	forEachTile(width, height, settings.tileSize, [&](const Tile& tile, unsigned int) {
+		for (int row = tile.y0; row < tile.y1; row++) {
+			// Row 0 is the top of the image, the highest y in clip space.
+			float ndcY = ((float)(height - 1 - row) + 0.5f) * scene.ndcScale[1] - 1.0f;
+			unsigned char* dst = image + (size_t)row * width * 4;
+			int x = tile.x0;
+#ifdef CPURAYCASTER_AVX2
+			for (; packets && x < tile.x1; x += 8) {
+				float color[4][8];
+				int lanes = std::min(tile.x1 - x, 8);
+				tracePacket<L>(scene, x, lanes, ndcY, color);
+				for (int i = 0; i < lanes; i++)
+					for (int c = 0; c < 4; c++)
+						dst[(x + i) * 4 + c] = toUnorm8(color[c][i]);
+			}
+#endif
+			for (; x < tile.x1; x++) {
+				float color[4];
+				traceScalar<L>(scene, (x + 0.5f) * scene.ndcScale[0] - 1.0f, ndcY, color);
+				for (int c = 0; c < 4; c++)
+					dst[x * 4 + c] = toUnorm8(color[c]);
+			}
+		}
+	}, out_stats, settings.workers);
+}
+
+void cpuRaycast(
+	const CpuVolume & volume,
+	const unsigned char * colormap,
+	int colormapSize,
+	const CpuRaycastSettings & settings,
+	std::vector<unsigned char> & out_rgba,
+	TileStats * out_stats)
+{
+	int width = std::max(settings.width, 0);
+	int height = std::max(settings.height, 0);
+	out_rgba.assign((size_t)width * height * 4, 0);
+	Scene scene;
+	if (volume.values.empty() || colormapSize <= 0 || !invert(settings.model, scene.clip))
+		return;
+	scene.values = volume.values.data();
+	for (int a = 0; a < 3; a++) {
+		scene.dims[a] = volume.dims[a];
+		scene.boxMin[a] = settings.boxMin[a];
+		scene.invBoxSize[a] = 1.0f / settings.boxSize[a];
+	}
+	scene.grid = volume.grid;
+	scene.colormapSize = std::min(colormapSize, 256);
+	for (int i = 0; i < scene.colormapSize; i++)
+		for (int c = 0; c < 3; c++)
+			scene.colormap[c][i] = colormap[4 * i + c] / 255.0f;
+	scene.stepScale = settings.stepScale;
+	scene.compositing = settings.compositing;
+	scene.opacityCutoff = settings.opacityCutoff;
+	scene.ndcScale[0] = 2.0f / std::max(width, 1);
+	scene.ndcScale[1] = 2.0f / std::max(height, 1);
+
+	bool packets = false;
+#ifdef CPURAYCASTER_AVX2
+	// Gathers take 32-bit indices, and packets spread Morton codes over 10
+	// bits per axis.
+	uint32_t largest = std::max(volume.grid.dims[0], std::max(volume.grid.dims[1], volume.grid.dims[2]));
+	packets = settings.packets && volume.values.size() <= (size_t)INT32_MAX &&
+		(volume.grid.layout != VoxelLayout::Morton || largest <= 1024);
+#endif
+	unsigned char* image = out_rgba.data();
+	switch (volume.grid.layout)
+	{
+	case VoxelLayout::Linear: renderTiles<VoxelLayout::Linear>(scene, width, height, packets, settings, image, out_stats); break;
+	case VoxelLayout::Blocked: renderTiles<VoxelLayout::Blocked>(scene, width, height, packets, settings, image, out_stats); break;
+	case VoxelLayout::Morton: renderTiles<VoxelLayout::Morton>(scene, width, height, packets, settings, image, out_stats); break;
+	}
+}
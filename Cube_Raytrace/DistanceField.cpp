@@ -0,0 +1,157 @@
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+
+#include "distancefield.hpp"
+#include "parallel.hpp"
+#include "renderer.hpp"
+
+DistanceField::DistanceField(const MacroCellGrid & grid, int maxDistance)
+	: m_Grid(grid), m_MaxDistance(std::max(1, std::min(maxDistance, 255)))
+{
+	m_Occupied.assign(grid.cellCount(), 1);
+	m_Distance.assign(grid.cellCount(), 0);
+
+	GLCall(glGenTextures(1, &m_Texture));
+	GLCall(glBindTexture(GL_TEXTURE_3D, m_Texture));
+	GLCall(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+	GLCall(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+	GLCall(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE));
+	GLCall(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+	GLCall(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+	GLCall(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+	GLCall(glTexImage3D(GL_TEXTURE_3D, 0, GL_R8UI, grid.dims[0], grid.dims[1], grid.dims[2], 0,
+		GL_RED_INTEGER, GL_UNSIGNED_BYTE, m_Distance.data()));
+	GLCall(glBindTexture(GL_TEXTURE_3D, 0));
+}
+
+DistanceField::~DistanceField()
+{
+	GLCall(glDeleteTextures(1, &m_Texture));
+}
+
+bool DistanceField::update(float threshold)
+{
+	if (m_HaveThreshold && threshold == m_Threshold)
+		return false;
+	auto start = std::chrono::steady_clock::now();
+
+	// Cells whose occupancy flips; only their neighbourhood can change.
+	const int* dims = m_Grid.dims;
+	int changedMin[3] = { dims[0], dims[1], dims[2] };
+	int changedMax[3] = { -1, -1, -1 };
+	for (int z = 0; z < dims[2]; z++)
+		for (int y = 0; y < dims[1]; y++)
+			for (int x = 0; x < dims[0]; x++)
+			{
+				size_t i = ((size_t)z * dims[1] + y) * dims[0] + x;
+				unsigned char occupied = m_Grid.minMax[i * 2 + 1] > threshold ? 1 : 0;
+				if (m_HaveThreshold && occupied == m_Occupied[i])
+					continue;
+				m_Occupied[i] = occupied;
+				int cell[3] = { x, y, z };
+				for (int a = 0; a < 3; a++)
+				{
+					changedMin[a] = std::min(changedMin[a], cell[a]);
+					changedMax[a] = std::max(changedMax[a], cell[a]);
+				}
+			}
+	m_Threshold = threshold;
+	bool full = !m_HaveThreshold;
+	m_HaveThreshold = true;
+	if (changedMax[0] < 0 && !full)
+		return false;
+	if (full) {
+		for (int a = 0; a < 3; a++)
+		{
+			changedMin[a] = 0;
+			changedMax[a] = dims[a] - 1;
+		}
+	}
+
+	// A capped distance only depends on cells less than maxDistance away.
+	int reach = m_MaxDistance - 1;
+	int writeMin[3], writeMax[3], windowMin[3], windowMax[3];
+	for (int a = 0; a < 3; a++)
+	{
+		writeMin[a] = std::max(0, changedMin[a] - reach);
+		writeMax[a] = std::min(dims[a], changedMax[a] + reach + 1);
+		windowMin[a] = std::max(0, writeMin[a] - reach);
+		windowMax[a] = std::min(dims[a], writeMax[a] + reach);
+	}
+	compute(windowMin, windowMax, writeMin, writeMax);
+
+	// Upload the touched slab of whole slices.
+	size_t slice = (size_t)dims[0] * dims[1];
+	GLCall(glBindTexture(GL_TEXTURE_3D, m_Texture));
+	GLCall(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+	GLCall(glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, writeMin[2], dims[0], dims[1], writeMax[2] - writeMin[2],
+		GL_RED_INTEGER, GL_UNSIGNED_BYTE, &m_Distance[writeMin[2] * slice]));
+	GLCall(glBindTexture(GL_TEXTURE_3D, 0));
+
+	m_LastBuildCells = (size_t)(writeMax[0] - writeMin[0]) * (writeMax[1] - writeMin[1]) * (writeMax[2] - writeMin[2]);
+	m_LastBuildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return true;
+}
+
+void DistanceField::compute(const int windowMin[3], const int windowMax[3], const int writeMin[3], const int writeMax[3])
+{
+	const int* dims = m_Grid.dims;
+	int w[3] = { windowMax[0] - windowMin[0], windowMax[1] - windowMin[1], windowMax[2] - windowMin[2] };
+	size_t count = (size_t)w[0] * w[1] * w[2];
+	unsigned char cap = (unsigned char)m_MaxDistance;
+	std::vector<unsigned char> alongX(count), alongY(count);
+	auto local = [&](int x, int y, int z) { return ((size_t)z * w[1] + y) * w[0] + x; };
+
+	// x: distance to the nearest occupied cell on the same row, two sweeps.
+	parallelFor(0, w[2], 1, [&](size_t zb, size_t ze, size_t) {
+		for (int z = (int)zb; z < (int)ze; z++)
+			for (int y = 0; y < w[1]; y++)
+			{
+				const unsigned char* occupied = &m_Occupied[((size_t)(z + windowMin[2]) * dims[1] + y + windowMin[1]) * dims[0] + windowMin[0]];
+				unsigned char* out = &alongX[local(0, y, z)];
+				int d = cap;
+				for (int x = 0; x < w[0]; x++)
+				{
+					d = occupied[x] ? 0 : std::min(d + 1, (int)cap);
+					out[x] = (unsigned char)d;
+				}
+				d = cap;
+				for (int x = w[0] - 1; x >= 0; x--)
+				{
+					d = occupied[x] ? 0 : std::min(d + 1, (int)cap);
+					out[x] = (unsigned char)std::min((int)out[x], d);
+				}
+			}
+	});
+
+	// y, then z: min over k of max(k, previous pass at offset k). The scan
+	// stops once k reaches the best value found so far.
+	auto scan = [cap](const unsigned char * line, size_t stride, int length, int i) {
+		int best = line[i * stride];
+		for (int k = 1; k < best && k < cap; k++)
+		{
+			if (i - k >= 0)
+				best = std::min(best, std::max(k, (int)line[(i - k) * stride]));
+			if (i + k < length)
+				best = std::min(best, std::max(k, (int)line[(i + k) * stride]));
+		}
+		return best;
+	};
+	parallelFor(0, w[2], 1, [&](size_t zb, size_t ze, size_t) {
+		for (int z = (int)zb; z < (int)ze; z++)
+			for (int y = 0; y < w[1]; y++)
+				for (int x = 0; x < w[0]; x++)
+					alongY[local(x, y, z)] = (unsigned char)scan(&alongX[local(x, 0, z)], w[0], w[1], y);
+	});
+	size_t slice = (size_t)w[0] * w[1];
+	parallelFor(writeMin[1], writeMax[1], 1, [&](size_t yb, size_t ye, size_t) {
+		for (int y = (int)yb; y < (int)ye; y++)
+			for (int z = writeMin[2]; z < writeMax[2]; z++)
+				for (int x = writeMin[0]; x < writeMax[0]; x++)
+				{
+					const unsigned char* line = &alongY[local(x - windowMin[0], y - windowMin[1], 0)];
+					m_Distance[((size_t)z * dims[1] + y) * dims[0] + x] = (unsigned char)scan(line, slice, w[2], z - windowMin[2]);
+				}
+	});
+}
@@ -0,0 +1,96 @@
+#include <algorithm>
+#include <cmath>
+
+#include "dynamicresolution.hpp"
+#include "renderer.hpp"
+
+DynamicResolution::DynamicResolution(double budgetMs)
+	: m_BudgetMs(budgetMs)
+{
+	for (Query& query : m_Queries) {
+		GLCall(glGenQueries(1, &query.id));
+	}
+}
+
+DynamicResolution::~DynamicResolution()
+{
+	for (Query& query : m_Queries) {
+		GLCall(glDeleteQueries(1, &query.id));
+	}
+}
+
+void DynamicResolution::beginFrame()
+{
+	// Relative cost of this frame: pixels over step factor.
+	begin(m_Scale * m_Scale / m_StepFactor, false);
+}
+
+void DynamicResolution::beginRefinement(float coverage)
+{
+	begin(coverage, true);
+}
+
+void DynamicResolution::begin(float quality, bool refinement)
+{
+	Query& query = m_Queries[m_Next];
+	if (query.pending || m_Active >= 0)
+		return;
+	query.quality = quality;
+	query.refinement = refinement;
+	GLCall(glBeginQuery(GL_TIME_ELAPSED, query.id));
+	m_Active = m_Next;
+}
+
+void DynamicResolution::endFrame()
+{
+	if (m_Active < 0)
+		return;
+	GLCall(glEndQuery(GL_TIME_ELAPSED));
+	m_Queries[m_Active].pending = true;
+	m_Next = (m_Active + 1) % kQueries;
+	m_Active = -1;
+}
+
+void DynamicResolution::update()
+{
+	// Oldest first, so the last result read is the most recent.
+	for (int i = 0; i < kQueries; i++) {
+		Query& query = m_Queries[(m_Next + i) % kQueries];
+		if (!query.pending)
+			continue;
+		GLint available = GL_FALSE;
+		GLCall(glGetQueryObjectiv(query.id, GL_QUERY_RESULT_AVAILABLE, &available));
+		if (available != GL_TRUE)
+			break;
+		GLuint64 ns = 0;
+		GLCall(glGetQueryObjectui64v(query.id, GL_QUERY_RESULT, &ns));
+		query.pending = false;
+
+		double ms = ns / 1.0e6;
+		m_Stats.lastMs = ms;
+		m_Stats.averageMs = m_Stats.frames == 0 ? ms : 0.9 * m_Stats.averageMs + 0.1 * ms;
+		m_Stats.frames++;
+		if (query.refinement)
+			m_Stats.refinementFrames++;
+		else if (query.quality < 1.0f)
+			m_Stats.degradedFrames++;
+		if (ms > m_BudgetMs)
+			m_Stats.overBudgetFrames++;
+		adjust(ms / query.quality);
+	}
+}
+
+void DynamicResolution::adjust(double fullQualityMs)
+{
+	m_FullQualityMs = m_FullQualityMs == 0.0 ? fullQualityMs : 0.75 * m_FullQualityMs + 0.25 * fullQualityMs;
+	double quality = std::min(targetFraction * m_BudgetMs / m_FullQualityMs, 1.0);
+	float scale = std::max((float)std::sqrt(quality), minScale);
+	float stepFactor = std::min(std::max(scale * scale / (float)quality, 1.0f), maxStepFactor);
+	// Dead band of 5% in either direction, except to get back to full quality.
+	float current = m_Scale * m_Scale / m_StepFactor;
+	float next = scale * scale / stepFactor;
+	if (next < 1.0f && std::fabs(next - current) < 0.05f * current)
+		return;
+	m_Scale = scale;
+	m_StepFactor = stepFactor;
+}
@@ -0,0 +1,326 @@
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+#include "glcontext.hpp"
+#include "renderer.hpp"
+
+#ifdef GLCONTEXT_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+void GLContext::readPixels(std::vector<unsigned char> & out_rgba) const
+{
+	int width, height;
+	framebufferSize(width, height);
+	size_t stride = (size_t)width * 4;
+	out_rgba.resize(stride * height);
+	GLCall(glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer()));
+	GLCall(glPixelStorei(GL_PACK_ALIGNMENT, 1));
+	GLCall(glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, out_rgba.data()));
+	GLCall(glBindFramebuffer(GL_READ_FRAMEBUFFER, 0));
+	// GL rows run bottom up.
+	std::vector<unsigned char> row(stride);
+	for (int y = 0; y < height / 2; y++) {
+		unsigned char* top = &out_rgba[y * stride];
+		unsigned char* bottom = &out_rgba[(height - 1 - y) * stride];
+		memcpy(row.data(), top, stride);
+		memcpy(top, bottom, stride);
+		memcpy(bottom, row.data(), stride);
+	}
+}
+
+namespace {
+
+void contextHints()
+{
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+}
+
+class WindowContext : public GLContext
+{
+public:
+	// owner: this context's window is the main one and GLFW goes with it.
+	WindowContext(GLFWwindow * window, bool owner) : m_Window(window), m_Owner(owner) {}
+
+	~WindowContext()
+	{
+		glfwDestroyWindow(m_Window);
+		if (m_Owner)
+			glfwTerminate();
+	}
+
+	GLContextBackend backend() const override { return GLContextBackend::Window; }
+	unsigned int framebuffer() const override { return 0; }
+	void framebufferSize(int & width, int & height) const override { glfwGetFramebufferSize(m_Window, &width, &height); }
+
+	void present(double waitSeconds) override
+	{
+		glfwSwapBuffers(m_Window);
+		if (waitSeconds > 0.0)
+			glfwWaitEventsTimeout(waitSeconds);
+		else
+			glfwPollEvents();
+	}
+
+	bool shouldClose() const override { return glfwWindowShouldClose(m_Window) != 0; }
+	double time() const override { return glfwGetTime(); }
+	GLFWwindow* window() const override { return m_Window; }
+
+	std::unique_ptr<GLContext> createShared() override
+	{
+		// An invisible 1x1 window only to own a context that shares objects
+		// with this one.
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		contextHints();
+		GLFWwindow* shared = glfwCreateWindow(1, 1, "Shared context", NULL, m_Window);
+		glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+		if (shared == NULL)
+			return nullptr;
+		return std::unique_ptr<GLContext>(new WindowContext(shared, false));
+	}
+
+	void makeCurrent() override { glfwMakeContextCurrent(m_Window); }
+	void releaseCurrent() override { glfwMakeContextCurrent(NULL); }
+
+private:
+	GLFWwindow* m_Window;
+	bool m_Owner;
+};
+
+std::unique_ptr<GLContext> createWindowContext(int width, int height, const char * title)
+{
+	if (!glfwInit()) {
+		fprintf(stderr, "Failed to initialize GLFW\n");
+		return nullptr;
+	}
+	glfwWindowHint(GLFW_SAMPLES, 4);
+	contextHints();
+	GLFWwindow* window = glfwCreateWindow(width, height, title, NULL, NULL);
+	if (window == NULL) {
+		fprintf(stderr, "Failed to open GLFW window. If you have an Intel GPU, they are not 3.3 compatible. Try the 2.1 version of the tutorials.\n");
+		glfwTerminate();
+		return nullptr;
+	}
+	glfwMakeContextCurrent(window);
+	return std::unique_ptr<GLContext>(new WindowContext(window, true));
+}
+
+#ifdef GLCONTEXT_EGL
+
+bool hasExtension(const char * extensions, const char * name)
+{
+	size_t length = strlen(name);
+	for (const char* p = extensions; p && (p = strstr(p, name)) != NULL; p += length)
+		if ((p == extensions || p[-1] == ' ') && (p[length] == ' ' || p[length] == '\0'))
+			return true;
+	return false;
+}
+
+class EglContext : public GLContext
+{
+public:
+	EglContext(EGLDisplay display, EGLConfig config, EGLContext context, EGLSurface surface, bool owner, int width, int height)
+		: m_Display(display), m_Config(config), m_Context(context), m_Surface(surface), m_Owner(owner),
+		m_Width(width), m_Height(height), m_Start(std::chrono::steady_clock::now())
+	{
+	}
+
+	~EglContext()
+	{
+		if (m_Framebuffer != 0) {
+			makeCurrent();
+			GLCall(glDeleteFramebuffers(1, &m_Framebuffer));
+			GLCall(glDeleteRenderbuffers(2, m_Renderbuffers));
+		}
+		// A shared context goes away on the main thread, whose own context
+		// has to stay current.
+		if (eglGetCurrentContext() == m_Context)
+			eglMakeCurrent(m_Display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if (m_Surface != EGL_NO_SURFACE)
+			eglDestroySurface(m_Display, m_Surface);
+		eglDestroyContext(m_Display, m_Context);
+		if (m_Owner)
+			eglTerminate(m_Display);
+	}
+
+	// The offscreen target; needs the context current and GLEW initialized.
+	bool createTarget()
+	{
+		GLCall(glGenRenderbuffers(2, m_Renderbuffers));
+		GLCall(glBindRenderbuffer(GL_RENDERBUFFER, m_Renderbuffers[0]));
+		GLCall(glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, m_Width, m_Height));
+		GLCall(glBindRenderbuffer(GL_RENDERBUFFER, m_Renderbuffers[1]));
+		GLCall(glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, m_Width, m_Height));
+		GLCall(glBindRenderbuffer(GL_RENDERBUFFER, 0));
+		GLCall(glGenFramebuffers(1, &m_Framebuffer));
+		GLCall(glBindFramebuffer(GL_FRAMEBUFFER, m_Framebuffer));
+		GLCall(glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_Renderbuffers[0]));
+		GLCall(glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_Renderbuffers[1]));
+		GLCall(GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER));
+		GLCall(glViewport(0, 0, m_Width, m_Height));
+		return status == GL_FRAMEBUFFER_COMPLETE;
+	}
+
+	GLContextBackend backend() const override { return GLContextBackend::Headless; }
+	unsigned int framebuffer() const override { return m_Framebuffer; }
+
+	void framebufferSize(int & width, int & height) const override
+	{
+		width = m_Width;
+		height = m_Height;
+	}
+
+	// Nothing to show; flushing keeps a frame from queueing behind the next.
+	void present(double) override { GLCall(glFlush()); }
+	bool shouldClose() const override { return false; }
+
+	double time() const override
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_Start).count();
+	}
+
+	std::unique_ptr<GLContext> createShared() override;
+
+	void makeCurrent() override { eglMakeCurrent(m_Display, m_Surface, m_Surface, m_Context); }
+	void releaseCurrent() override { eglMakeCurrent(m_Display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT); }
+
+	static std::unique_ptr<EglContext> create(EGLDisplay display, EGLConfig config, EGLContext share, bool owner, int width, int height);
+
+private:
+	EGLDisplay m_Display;
+	EGLConfig m_Config;
+	EGLContext m_Context;
+	EGLSurface m_Surface;
+	bool m_Owner;
+	int m_Width;
+	int m_Height;
+	std::chrono::steady_clock::time_point m_Start;
+	unsigned int m_Framebuffer = 0;
+	unsigned int m_Renderbuffers[2] = { 0, 0 };
+};
+
+std::unique_ptr<EglContext> EglContext::create(EGLDisplay display, EGLConfig config, EGLContext share, bool owner, int width, int height)
+{
+	const EGLint attributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	EGLContext context = eglCreateContext(display, config, share, attributes);
+	if (context == EGL_NO_CONTEXT) {
+		fprintf(stderr, "eglCreateContext failed (0x%04x), no OpenGL 3.3 core context\n", eglGetError());
+		return nullptr;
+	}
+	// Every context renders into framebuffer objects, so a surface is only
+	// made when the driver will not make a context current without one.
+	EGLSurface surface = EGL_NO_SURFACE;
+	if (!hasExtension(eglQueryString(display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context")) {
+		const EGLint pbuffer[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+		surface = eglCreatePbufferSurface(display, config, pbuffer);
+		if (surface == EGL_NO_SURFACE) {
+			fprintf(stderr, "eglCreatePbufferSurface failed (0x%04x)\n", eglGetError());
+			eglDestroyContext(display, context);
+			return nullptr;
+		}
+	}
+	return std::unique_ptr<EglContext>(new EglContext(display, config, context, surface, owner, width, height));
+}
+
+std::unique_ptr<GLContext> EglContext::createShared()
+{
+	return EglContext::create(m_Display, m_Config, m_Context, false, 1, 1);
+}
+
+std::unique_ptr<GLContext> createHeadlessContext(int width, int height)
+{
+	// Mesa's surfaceless platform needs neither X11 nor a GPU device; other
+	// drivers get the default display.
+	EGLDisplay display = EGL_NO_DISPLAY;
+	if (hasExtension(eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS), "EGL_MESA_platform_surfaceless")) {
+		PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+		if (getPlatformDisplay)
+			display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	}
+	if (display == EGL_NO_DISPLAY)
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	EGLint major, minor;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+		fprintf(stderr, "Failed to initialize EGL (0x%04x)\n", eglGetError());
+		return nullptr;
+	}
+	const EGLint configAttributes[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8,
+		EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE, 8,
+		EGL_ALPHA_SIZE, 8,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint configs = 0;
+	if (!eglBindAPI(EGL_OPENGL_API) || !eglChooseConfig(display, configAttributes, &config, 1, &configs) || configs == 0) {
+		fprintf(stderr, "EGL %d.%d offers no desktop OpenGL config\n", major, minor);
+		eglTerminate(display);
+		return nullptr;
+	}
+	std::unique_ptr<EglContext> context = EglContext::create(display, config, EGL_NO_CONTEXT, true, width, height);
+	if (!context) {
+		eglTerminate(display);
+		return nullptr;
+	}
+	context->makeCurrent();
+	return context;
+}
+
+#endif
+
+}
+
+std::unique_ptr<GLContext> createGLContext(GLContextBackend backend, int width, int height, const char * title)
+{
+	std::unique_ptr<GLContext> context;
+	if (backend == GLContextBackend::Window) {
+		context = createWindowContext(width, height, title);
+	}
+	else {
+#ifdef GLCONTEXT_EGL
+		context = createHeadlessContext(width, height);
+#else
+		fprintf(stderr, "Built without EGL, no headless context\n");
+#endif
+	}
+	if (!context)
+		return nullptr;
+	glewExperimental = true;
+	GLenum glewStatus = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+	// A GLX build of GLEW still loads the GL entry points without an X
+	// display, it only misses the GLX extensions.
+	if (glewStatus == GLEW_ERROR_NO_GLX_DISPLAY && backend == GLContextBackend::Headless)
+		glewStatus = GLEW_OK;
+#endif
+	if (glewStatus != GLEW_OK) {
+		fprintf(stderr, "Failed to initialize GLEW\n");
+		return nullptr;
+	}
+#ifdef GLCONTEXT_EGL
+	if (backend == GLContextBackend::Headless && !static_cast<EglContext*>(context.get())->createTarget()) {
+		fprintf(stderr, "Offscreen framebuffer incomplete\n");
+		return nullptr;
+	}
+#endif
+	if (backend == GLContextBackend::Headless) {
+		const char* renderer = (const char*)glGetString(GL_RENDERER);
+		printf("Headless OpenGL context on %s\n", renderer ? renderer : "an unknown renderer");
+	}
+	return context;
+}
@@ -0,0 +1,405 @@
+#include <stdio.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "gradientvolume.hpp"
+#include "parallel.hpp"
+#include "renderer.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define GRADIENT_SSE2 1
+#endif
+
+bool parseGradientFilter(const char * name, GradientFilter & out_filter)
+{
+	if (strcmp(name, "central") == 0)
+		out_filter = GradientFilter::Central;
+	else if (strcmp(name, "sobel") == 0)
+		out_filter = GradientFilter::Sobel;
+	else
+		return false;
+	return true;
+}
+
+bool parseGradientFormat(const char * name, GradientFormat & out_format)
+{
+	if (strcmp(name, "rgba8") == 0)
+		out_format = GradientFormat::RGBA8;
+	else if (strcmp(name, "rgb10a2") == 0)
+		out_format = GradientFormat::RGB10A2;
+	else
+		return false;
+	return true;
+}
+
+const char* gradientFilterName(GradientFilter filter)
+{
+	return filter == GradientFilter::Sobel ? "sobel" : "central";
+}
+
+const char* gradientFormatName(GradientFormat format)
+{
+	return format == GradientFormat::RGB10A2 ? "rgb10a2" : "rgba8";
+}
+
+// Rows of a raw volume, clamped at the edges.
+template <typename T>
+struct RawRows
+{
+	const T* voxels;
+	int dx, dy, dz;
+
+	// Row (y, z) as floats with one clamped voxel of padding on each end.
+	void load(int y, int z, float * out) const
+	{
+		y = std::min(std::max(y, 0), dy - 1);
+		z = std::min(std::max(z, 0), dz - 1);
+		const T* row = voxels + ((size_t)z * dy + y) * dx;
+		out[0] = (float)row[0];
+		for (int x = 0; x < dx; x++)
+			out[x + 1] = (float)row[x];
+		out[dx + 1] = (float)row[dx - 1];
+	}
+};
+
+// Rows of one stored brick; y and z run from -1 to the brick size, the
+// padding and the outer rows coming from the apron.
+template <typename T>
+struct BrickRows
+{
+	const T* stored;
+	int storedSize;
+	int apron;
+	int width;
+
+	void load(int y, int z, float * out) const
+	{
+		const T* row = stored + ((size_t)(z + apron) * storedSize + (y + apron)) * storedSize + apron - 1;
+		for (int x = 0; x < width + 2; x++)
+			out[x] = (float)row[x];
+	}
+};
+
+// Per-thread rolling window over the rows of one slice. Every row y of
+// the slice is converted once, together with the rows above and below it
+// in z, and kept as its centre row, its z difference and (Sobel) its 1-2-1
+// smoothing across z, in slot y mod 3. Stepping to the next row then only
+// converts row y + 2 of the three planes.
+struct GradientScratch
+{
+	std::vector<float> below, above;
+	std::vector<float> center[3], diff[3], smooth[3];
+	std::vector<float> a, dy, dz;
+	std::vector<float> gx, gy, gz;
+	// Last row computed, to tell a step to the next row from a jump.
+	int y = 0, z = -1;
+
+	explicit GradientScratch(int width)
+	{
+		below.resize(width + 2);
+		above.resize(width + 2);
+		for (int i = 0; i < 3; i++)
+		{
+			center[i].resize(width + 2);
+			diff[i].resize(width + 2);
+			smooth[i].resize(width + 2);
+		}
+		a.resize(width + 2);
+		dy.resize(width + 2);
+		dz.resize(width + 2);
+		gx.resize(width);
+		gy.resize(width);
+		gz.resize(width);
+	}
+};
+
+static int windowSlot(int y)
+{
+	return (y % 3 + 3) % 3;
+}
+
+// out = a - b over n floats.
+static void differenceRow(const float * a, const float * b, float * out, int n)
+{
+	int i = 0;
+#ifdef GRADIENT_SSE2
+	for (; i + 4 <= n; i += 4)
+		_mm_storeu_ps(out + i, _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+#endif
+	for (; i < n; i++)
+		out[i] = a[i] - b[i];
+}
+
+// out = 1-2-1 smoothing of a, b and c over n floats.
+static void smoothRow(const float * a, const float * b, const float * c, float * out, int n)
+{
+	int i = 0;
+#ifdef GRADIENT_SSE2
+	const __m128 quarter = _mm_set1_ps(0.25f);
+	const __m128 half = _mm_set1_ps(0.5f);
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128 v = _mm_add_ps(_mm_mul_ps(quarter, _mm_loadu_ps(a + i)), _mm_mul_ps(half, _mm_loadu_ps(b + i)));
+		_mm_storeu_ps(out + i, _mm_add_ps(v, _mm_mul_ps(quarter, _mm_loadu_ps(c + i))));
+	}
+#endif
+	for (; i < n; i++)
+		out[i] = 0.25f * a[i] + 0.5f * b[i] + 0.25f * c[i];
+}
+
+template <typename Source>
+static void loadWindowRow(const Source & src, int y, int z, int width, GradientFilter filter, GradientScratch & s)
+{
+	int slot = windowSlot(y);
+	src.load(y, z - 1, s.below.data());
+	src.load(y, z, s.center[slot].data());
+	src.load(y, z + 1, s.above.data());
+	differenceRow(s.above.data(), s.below.data(), s.diff[slot].data(), width + 2);
+	if (filter == GradientFilter::Sobel)
+		smoothRow(s.below.data(), s.center[slot].data(), s.above.data(), s.smooth[slot].data(), width + 2);
+}
+
+template <typename Source>
+static void gradientRow(const Source & src, int y, int z, int width, GradientFilter filter, GradientScratch & s)
+{
+	if (z == s.z && y == s.y + 1)
+		loadWindowRow(src, y + 1, z, width, filter, s);
+	else
+		for (int j = y - 1; j <= y + 1; j++)
+			loadWindowRow(src, j, z, width, filter, s);
+	s.y = y;
+	s.z = z;
+
+	int prev = windowSlot(y - 1), cur = windowSlot(y), next = windowSlot(y + 1);
+	if (filter == GradientFilter::Central) {
+		const float* c = s.center[cur].data();
+		differenceRow(c + 2, c, s.gx.data(), width);
+		differenceRow(s.center[next].data() + 1, s.center[prev].data() + 1, s.gy.data(), width);
+		std::copy(s.diff[cur].begin() + 1, s.diff[cur].begin() + 1 + width, s.gz.begin());
+		return;
+	}
+
+	// a smooths across y and z, dy and dz difference across one of them and
+	// smooth across the other; the last smoothing along x happens below.
+	int n = width + 2;
+	smoothRow(s.smooth[prev].data(), s.smooth[cur].data(), s.smooth[next].data(), s.a.data(), n);
+	differenceRow(s.smooth[next].data(), s.smooth[prev].data(), s.dy.data(), n);
+	smoothRow(s.diff[prev].data(), s.diff[cur].data(), s.diff[next].data(), s.dz.data(), n);
+	differenceRow(s.a.data() + 2, s.a.data(), s.gx.data(), width);
+	smoothRow(s.dy.data(), s.dy.data() + 1, s.dy.data() + 2, s.gy.data(), width);
+	smoothRow(s.dz.data(), s.dz.data() + 1, s.dz.data() + 2, s.gz.data(), width);
+}
+
+static float rowMaxMagnitude(const GradientScratch & s, int width)
+{
+	float maxSq = 0.0f;
+	for (int x = 0; x < width; x++)
+		maxSq = std::max(maxSq, s.gx[x] * s.gx[x] + s.gy[x] * s.gy[x] + s.gz[x] * s.gz[x]);
+	return std::sqrt(maxSq);
+}
+
+static uint32_t packGradient(float gx, float gy, float gz, float invMax, GradientFormat format)
+{
+	if (format == GradientFormat::RGB10A2) {
+		auto q = [&](float g) { return (uint32_t)((std::min(std::max(g * invMax, -1.0f), 1.0f) * 0.5f + 0.5f) * 1023.0f + 0.5f); };
+		return q(gx) | q(gy) << 10 | q(gz) << 20 | 3u << 30;
+	}
+	float len = std::sqrt(gx * gx + gy * gy + gz * gz);
+	float inv = len > 0.0f ? 1.0f / len : 0.0f;
+	auto q = [&](float n) { return (uint32_t)((n * 0.5f + 0.5f) * 255.0f + 0.5f); };
+	uint32_t a = (uint32_t)(std::min(len * invMax, 1.0f) * 255.0f + 0.5f);
+	return q(gx * inv) | q(gy * inv) << 8 | q(gz * inv) << 16 | a << 24;
+}
+
+static void packRow(const GradientScratch & s, int width, float invMax, GradientFormat format, uint32_t * out)
+{
+	int x = 0;
+#ifdef GRADIENT_SSE2
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 minusOne = _mm_set1_ps(-1.0f);
+	const __m128 scaleMax = _mm_set1_ps(invMax);
+	if (format == GradientFormat::RGB10A2) {
+		const __m128 levels = _mm_set1_ps(1023.0f);
+		const __m128i alpha = _mm_set1_epi32((int)(3u << 30));
+		for (; x + 4 <= width; x += 4)
+		{
+			__m128i c[3];
+			const float* g[3] = { s.gx.data() + x, s.gy.data() + x, s.gz.data() + x };
+			for (int i = 0; i < 3; i++)
+			{
+				__m128 v = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(g[i]), scaleMax), minusOne), one);
+				v = _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(v, half), half), levels), half);
+				c[i] = _mm_cvttps_epi32(v);
+			}
+			__m128i packed = _mm_or_si128(_mm_or_si128(c[0], _mm_slli_epi32(c[1], 10)), _mm_or_si128(_mm_slli_epi32(c[2], 20), alpha));
+			_mm_storeu_si128((__m128i*)(out + x), packed);
+		}
+	}
+	else {
+		const __m128 levels = _mm_set1_ps(255.0f);
+		const __m128 zero = _mm_setzero_ps();
+		for (; x + 4 <= width; x += 4)
+		{
+			__m128 gx = _mm_loadu_ps(s.gx.data() + x);
+			__m128 gy = _mm_loadu_ps(s.gy.data() + x);
+			__m128 gz = _mm_loadu_ps(s.gz.data() + x);
+			__m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(gx, gx), _mm_mul_ps(gy, gy)), _mm_mul_ps(gz, gz)));
+			// 1 / 0 is masked back to 0 for zero gradients.
+			__m128 inv = _mm_and_ps(_mm_cmpgt_ps(len, zero), _mm_div_ps(one, len));
+			__m128 g[3] = { gx, gy, gz };
+			__m128i c[4];
+			for (int i = 0; i < 3; i++)
+			{
+				__m128 v = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(g[i], inv), half), half);
+				c[i] = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, levels), half));
+			}
+			c[3] = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_mul_ps(len, scaleMax), one), levels), half));
+			__m128i packed = _mm_or_si128(_mm_or_si128(c[0], _mm_slli_epi32(c[1], 8)), _mm_or_si128(_mm_slli_epi32(c[2], 16), _mm_slli_epi32(c[3], 24)));
+			_mm_storeu_si128((__m128i*)(out + x), packed);
+		}
+	}
+#endif
+	for (; x < width; x++)
+		out[x] = packGradient(s.gx[x], s.gy[x], s.gz[x], invMax, format);
+}
+
+static float inverseMagnitude(float maxMagnitude)
+{
+	return maxMagnitude > 0.0f ? 1.0f / maxMagnitude : 0.0f;
+}
+
+// Two passes over the rows, the first for the largest magnitude that the
+// packing is relative to; recomputing is cheaper than keeping three floats
+// per voxel around.
+template <typename T>
+void buildGradientVolume(const T * voxels, int dx, int dy, int dz, GradientFilter filter, GradientFormat format, GradientVolume & out)
+{
+	RawRows<T> src = { voxels, dx, dy, dz };
+	out.filter = filter;
+	out.format = format;
+	out.dims[0] = dx;
+	out.dims[1] = dy;
+	out.dims[2] = dz;
+	out.texels.assign((size_t)dx * dy * dz, 0);
+
+	std::vector<float> maxima(parallelChunkCount(dz, 1), 0.0f);
+	parallelFor(0, dz, 1, [&](size_t zb, size_t ze, size_t chunk) {
+		GradientScratch scratch(dx);
+		for (int z = (int)zb; z < (int)ze; z++)
+			for (int y = 0; y < dy; y++)
+			{
+				gradientRow(src, y, z, dx, filter, scratch);
+				maxima[chunk] = std::max(maxima[chunk], rowMaxMagnitude(scratch, dx));
+			}
+	});
+	out.maxMagnitude = *std::max_element(maxima.begin(), maxima.end());
+	float invMax = inverseMagnitude(out.maxMagnitude);
+	parallelFor(0, dz, 1, [&](size_t zb, size_t ze, size_t) {
+		GradientScratch scratch(dx);
+		for (int z = (int)zb; z < (int)ze; z++)
+			for (int y = 0; y < dy; y++)
+			{
+				gradientRow(src, y, z, dx, filter, scratch);
+				packRow(scratch, dx, invMax, format, &out.texels[((size_t)z * dy + y) * dx]);
+			}
+	});
+}
+
+template <typename T>
+static void buildBrickGradients(const BrickVolume & volume, const std::vector<int> & bricks, GradientFilter filter, GradientFormat format, GradientVolume & out)
+{
+	const BrickVolumeHeader& header = *volume.header;
+	int stored = brickStoredSize(header);
+	int dims[3] = { (int)header.dims[0], (int)header.dims[1], (int)header.dims[2] };
+	auto region = [&](int index, int offset[3], int size[3]) {
+		int coord[3] = {
+			index % (int)header.bricks[0],
+			(index / (int)header.bricks[0]) % (int)header.bricks[1],
+			index / (int)(header.bricks[0] * header.bricks[1])
+		};
+		for (int a = 0; a < 3; a++)
+		{
+			offset[a] = coord[a] * header.brickSize;
+			size[a] = std::min((int)header.brickSize, dims[a] - offset[a]);
+		}
+	};
+
+	for (int pass = 0; pass < 2; pass++)
+	{
+		std::vector<float> maxima(parallelChunkCount(bricks.size(), 1), 0.0f);
+		float invMax = inverseMagnitude(out.maxMagnitude);
+		parallelFor(0, bricks.size(), 1, [&](size_t bb, size_t be, size_t chunk) {
+			GradientScratch scratch(header.brickSize);
+			for (size_t i = bb; i < be; i++)
+			{
+				int offset[3], size[3];
+				region(bricks[i], offset, size);
+				BrickRows<T> src = { (const T*)brickData(volume, bricks[i]), stored, (int)header.apron, size[0] };
+				for (int z = 0; z < size[2]; z++)
+					for (int y = 0; y < size[1]; y++)
+					{
+						gradientRow(src, y, z, size[0], filter, scratch);
+						if (pass == 0)
+							maxima[chunk] = std::max(maxima[chunk], rowMaxMagnitude(scratch, size[0]));
+						else
+							packRow(scratch, size[0], invMax, format,
+								&out.texels[((size_t)(offset[2] + z) * dims[1] + offset[1] + y) * dims[0] + offset[0]]);
+					}
+			}
+		});
+		if (pass == 0)
+			out.maxMagnitude = *std::max_element(maxima.begin(), maxima.end());
+	}
+}
+
+bool buildGradientVolume(const BrickVolume & volume, const std::vector<int> & bricks, GradientFilter filter, GradientFormat format, GradientVolume & out)
+{
+	const BrickVolumeHeader& header = *volume.header;
+	if (header.apron < 1) {
+		printf("Gradients of a bricked volume need an apron of at least one voxel\n");
+		return false;
+	}
+	out.filter = filter;
+	out.format = format;
+	for (int a = 0; a < 3; a++)
+		out.dims[a] = (int)header.dims[a];
+	out.maxMagnitude = 0.0f;
+	// Zero packs to a zero-length gradient in both formats.
+	uint32_t zero = packGradient(0.0f, 0.0f, 0.0f, 0.0f, format);
+	out.texels.assign((size_t)out.dims[0] * out.dims[1] * out.dims[2], zero);
+	switch ((VoxelType)header.voxelType) {
+	case VoxelType::UInt8: buildBrickGradients<unsigned char>(volume, bricks, filter, format, out); break;
+	case VoxelType::UInt16: buildBrickGradients<unsigned short>(volume, bricks, filter, format, out); break;
+	case VoxelType::Int32: buildBrickGradients<int>(volume, bricks, filter, format, out); break;
+	case VoxelType::Float32: buildBrickGradients<float>(volume, bricks, filter, format, out); break;
+	}
+	return true;
+}
+
+unsigned int createGradientTexture(const GradientVolume & gradients)
+{
+	unsigned int id;
+	GLCall(glGenTextures(1, &id));
+	GLCall(glBindTexture(GL_TEXTURE_3D, id));
+	GLCall(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+	GLCall(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+	GLCall(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE));
+	GLCall(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+	GLCall(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+	GLenum internalFormat = gradients.format == GradientFormat::RGB10A2 ? GL_RGB10_A2 : GL_RGBA8;
+	GLenum type = gradients.format == GradientFormat::RGB10A2 ? GL_UNSIGNED_INT_2_10_10_10_REV : GL_UNSIGNED_INT_8_8_8_8_REV;
+	GLCall(glTexImage3D(GL_TEXTURE_3D, 0, internalFormat, gradients.dims[0], gradients.dims[1], gradients.dims[2], 0,
+		GL_RGBA, type, gradients.texels.data()));
+	GLCall(glBindTexture(GL_TEXTURE_3D, 0));
+	return id;
+}
+
+#define INSTANTIATE_GRADIENTVOLUME(T) \
+	template void buildGradientVolume<T>(const T *, int, int, int, GradientFilter, GradientFormat, GradientVolume &);
+INSTANTIATE_GRADIENTVOLUME(unsigned char)
+INSTANTIATE_GRADIENTVOLUME(unsigned short)
+INSTANTIATE_GRADIENTVOLUME(int)
+INSTANTIATE_GRADIENTVOLUME(float)
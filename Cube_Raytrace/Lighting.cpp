@@ -0,0 +1,25 @@
+#include "lighting.hpp"
+#include "renderer.hpp"
+
+unsigned int createLightingBuffer()
+{
+	unsigned int buffer;
+	GLCall(glGenBuffers(1, &buffer));
+	GLCall(glBindBuffer(GL_UNIFORM_BUFFER, buffer));
+	GLCall(glBufferData(GL_UNIFORM_BUFFER, sizeof(LightingBlock), nullptr, GL_DYNAMIC_DRAW));
+	GLCall(glBindBuffer(GL_UNIFORM_BUFFER, 0));
+	return buffer;
+}
+
+void updateLightingBuffer(unsigned int buffer, const LightingBlock & lighting)
+{
+	GLCall(glBindBuffer(GL_UNIFORM_BUFFER, buffer));
+	GLCall(glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(LightingBlock), &lighting));
+	GLCall(glBindBuffer(GL_UNIFORM_BUFFER, 0));
+	GLCall(glBindBufferBase(GL_UNIFORM_BUFFER, kLightingBinding, buffer));
+}
+
+void deleteLightingBuffer(unsigned int buffer)
+{
+	GLCall(glDeleteBuffers(1, &buffer));
+}
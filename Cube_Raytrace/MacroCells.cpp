@@ -0,0 +1,86 @@
+#include <algorithm>
+
+#include "macrocells.hpp"
+#include "parallel.hpp"
+#include "renderer.hpp"
+
+template <typename T>
+void buildMacroCells(const T * voxels, int dx, int dy, int dz, int cellSize, MacroCellGrid & out)
+{
+	int dims[3] = { dx, dy, dz };
+	out.cellSize = cellSize;
+	for (int a = 0; a < 3; a++)
+		out.dims[a] = (dims[a] + cellSize - 1) / cellSize;
+	out.minMax.resize(out.cellCount() * 2);
+	size_t row = dx;
+	size_t slice = row * dy;
+
+	parallelFor(0, out.dims[2], 1, [&](size_t zb, size_t ze, size_t) {
+		for (int cz = (int)zb; cz < (int)ze; cz++)
+			for (int cy = 0; cy < out.dims[1]; cy++)
+				for (int cx = 0; cx < out.dims[0]; cx++)
+				{
+					int cell[3] = { cx, cy, cz };
+					int begin[3], end[3];
+					for (int a = 0; a < 3; a++)
+					{
+						begin[a] = std::max(0, cell[a] * cellSize - 1);
+						end[a] = std::min(dims[a], (cell[a] + 1) * cellSize + 1);
+					}
+					T lo = voxels[begin[2] * slice + begin[1] * row + begin[0]];
+					T hi = lo;
+					for (int z = begin[2]; z < end[2]; z++)
+						for (int y = begin[1]; y < end[1]; y++)
+						{
+							const T* src = voxels + z * slice + y * row;
+							for (int x = begin[0]; x < end[0]; x++)
+							{
+								lo = std::min(lo, src[x]);
+								hi = std::max(hi, src[x]);
+							}
+						}
+					float* mm = &out.minMax[((size_t)cz * out.dims[1] * out.dims[0] + (size_t)cy * out.dims[0] + cx) * 2];
+					mm[0] = (float)lo;
+					mm[1] = (float)hi;
+				}
+	});
+}
+
+void macroCellsFromBricks(const BrickVolume & volume, MacroCellGrid & out)
+{
+	const BrickVolumeHeader& header = *volume.header;
+	out.cellSize = (int)header.brickSize;
+	for (int a = 0; a < 3; a++)
+		out.dims[a] = (int)header.bricks[a];
+	out.minMax.resize(out.cellCount() * 2);
+	for (size_t i = 0; i < brickCount(header); i++)
+	{
+		out.minMax[i * 2] = volume.table[i].min;
+		out.minMax[i * 2 + 1] = volume.table[i].max;
+	}
+}
+
+unsigned int createMacroCellTexture(const MacroCellGrid & grid, float valueScale)
+{
+	std::vector<float> texels(grid.minMax.size());
+	for (size_t i = 0; i < texels.size(); i++)
+		texels[i] = grid.minMax[i] / valueScale;
+
+	unsigned int id;
+	GLCall(glGenTextures(1, &id));
+	GLCall(glBindTexture(GL_TEXTURE_3D, id));
+	GLCall(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+	GLCall(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+	GLCall(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE));
+	GLCall(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+	GLCall(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+	GLCall(glPixelStorei(GL_UNPACK_ALIGNMENT, 4));
+	GLCall(glTexImage3D(GL_TEXTURE_3D, 0, GL_RG32F, grid.dims[0], grid.dims[1], grid.dims[2], 0, GL_RG, GL_FLOAT, texels.data()));
+	GLCall(glBindTexture(GL_TEXTURE_3D, 0));
+	return id;
+}
+
+template void buildMacroCells<unsigned char>(const unsigned char *, int, int, int, int, MacroCellGrid &);
+template void buildMacroCells<unsigned short>(const unsigned short *, int, int, int, int, MacroCellGrid &);
+template void buildMacroCells<int>(const int *, int, int, int, int, MacroCellGrid &);
+template void buildMacroCells<float>(const float *, int, int, int, int, MacroCellGrid &);
@@ -0,0 +1,250 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <cstdint>
+#include <cstring>
+
+#include "pngwriter.hpp"
+
+namespace {
+
+struct CrcTable
+{
+	uint32_t entries[256];
+
+	CrcTable()
+	{
+		for (uint32_t n = 0; n < 256; n++) {
+			uint32_t c = n;
+			for (int k = 0; k < 8; k++)
+				c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			entries[n] = c;
+		}
+	}
+};
+
+uint32_t crc32(const unsigned char * data, size_t size)
+{
+	// Built once, thread-safely, by the first encoder to get here.
+	static const CrcTable table;
+	uint32_t crc = 0xFFFFFFFFu;
+	for (size_t i = 0; i < size; i++)
+		crc = table.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+uint32_t adler32(const unsigned char * data, size_t size)
+{
+	uint32_t a = 1, b = 0;
+	while (size > 0) {
+		// 5552 bytes is the most that cannot overflow b before the modulo.
+		size_t block = size < 5552 ? size : 5552;
+		for (size_t i = 0; i < block; i++) {
+			a += data[i];
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+		data += block;
+		size -= block;
+	}
+	return (b << 16) | a;
+}
+
+// Deflate's bit order: values LSB first, Huffman codes MSB first.
+class BitWriter
+{
+public:
+	explicit BitWriter(std::vector<unsigned char> & out) : m_Out(out) {}
+
+	void bits(uint32_t value, int count)
+	{
+		m_Buffer |= (uint64_t)value << m_Count;
+		m_Count += count;
+		while (m_Count >= 8) {
+			m_Out.push_back((unsigned char)m_Buffer);
+			m_Buffer >>= 8;
+			m_Count -= 8;
+		}
+	}
+
+	void code(uint32_t code, int length)
+	{
+		uint32_t reversed = 0;
+		for (int i = 0; i < length; i++)
+			reversed |= ((code >> i) & 1) << (length - 1 - i);
+		bits(reversed, length);
+	}
+
+	void flush()
+	{
+		if (m_Count > 0)
+			bits(0, 8 - m_Count);
+	}
+
+private:
+	std::vector<unsigned char>& m_Out;
+	uint64_t m_Buffer = 0;
+	int m_Count = 0;
+};
+
+void literal(BitWriter & writer, int symbol)
+{
+	if (symbol < 144)
+		writer.code(0x30 + symbol, 8);
+	else if (symbol < 256)
+		writer.code(0x190 + symbol - 144, 9);
+	else if (symbol < 280)
+		writer.code(symbol - 256, 7);
+	else
+		writer.code(0xC0 + symbol - 280, 8);
+}
+
+const int lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+const int lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+const int distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+const int distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+void match(BitWriter & writer, int length, int distance)
+{
+	int l = 28;
+	while (lengthBase[l] > length)
+		l--;
+	literal(writer, 257 + l);
+	writer.bits(length - lengthBase[l], lengthExtra[l]);
+	int d = 29;
+	while (distanceBase[d] > distance)
+		d--;
+	writer.code(d, 5);
+	writer.bits(distance - distanceBase[d], distanceExtra[d]);
+}
+
+// zlib stream of a single fixed-Huffman block.
+void deflate(const std::vector<unsigned char> & data, std::vector<unsigned char> & out)
+{
+	const int hashBits = 15;
+	const size_t window = 32768;
+	const int maxLength = 258;
+	out.push_back(0x78);
+	out.push_back(0x01);
+	BitWriter writer(out);
+	writer.bits(1, 1);
+	writer.bits(1, 2);
+	// Position + 1 of the last occurrence of every hashed 4-byte prefix.
+	std::vector<uint32_t> head((size_t)1 << hashBits, 0);
+	size_t size = data.size();
+	size_t i = 0;
+	while (i < size) {
+		int length = 0;
+		size_t candidate = 0;
+		if (i + 4 <= size) {
+			uint32_t prefix;
+			memcpy(&prefix, &data[i], 4);
+			uint32_t hash = (prefix * 2654435761u) >> (32 - hashBits);
+			candidate = head[hash];
+			head[hash] = (uint32_t)(i + 1);
+			if (candidate > 0 && i - (candidate - 1) <= window) {
+				candidate--;
+				size_t limit = size - i < (size_t)maxLength ? size - i : (size_t)maxLength;
+				while ((size_t)length < limit && data[candidate + length] == data[i + length])
+					length++;
+			}
+		}
+		if (length >= 4) {
+			match(writer, length, (int)(i - candidate));
+			i += length;
+		}
+		else
+			literal(writer, data[i++]);
+	}
+	literal(writer, 256);
+	writer.flush();
+	uint32_t adler = adler32(data.data(), data.size());
+	for (int shift = 24; shift >= 0; shift -= 8)
+		out.push_back((unsigned char)(adler >> shift));
+}
+
+void put32(std::vector<unsigned char> & out, uint32_t value)
+{
+	for (int shift = 24; shift >= 0; shift -= 8)
+		out.push_back((unsigned char)(value >> shift));
+}
+
+void chunk(std::vector<unsigned char> & out, const char * type, const unsigned char * data, size_t size)
+{
+	put32(out, (uint32_t)size);
+	size_t start = out.size();
+	out.insert(out.end(), type, type + 4);
+	out.insert(out.end(), data, data + size);
+	put32(out, crc32(&out[start], size + 4));
+}
+
+int paeth(int a, int b, int c)
+{
+	int p = a + b - c;
+	int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+	if (pa <= pb && pa <= pc)
+		return a;
+	return pb <= pc ? b : c;
+}
+
+}
+
+void encodePng(int width, int height, const unsigned char * rgba, std::vector<unsigned char> & out_png)
+{
+	const size_t stride = (size_t)width * 4;
+	std::vector<unsigned char> filtered;
+	filtered.reserve((stride + 1) * height);
+	std::vector<unsigned char> candidates[4];
+	for (auto& candidate : candidates)
+		candidate.resize(stride);
+	for (int y = 0; y < height; y++) {
+		const unsigned char* row = rgba + y * stride;
+		const unsigned char* up = y > 0 ? row - stride : nullptr;
+		int best = 0;
+		uint64_t bestCost = UINT64_MAX;
+		for (int f = 0; f < 4; f++) {
+			uint64_t cost = 0;
+			for (size_t i = 0; i < stride; i++) {
+				int a = i >= 4 ? row[i - 4] : 0;
+				int b = up ? up[i] : 0;
+				int c = up && i >= 4 ? up[i - 4] : 0;
+				int predicted = f == 0 ? 0 : f == 1 ? a : f == 2 ? b : paeth(a, b, c);
+				unsigned char residual = (unsigned char)(row[i] - predicted);
+				candidates[f][i] = residual;
+				cost += (unsigned)abs((signed char)residual);
+			}
+			if (cost < bestCost) {
+				bestCost = cost;
+				best = f;
+			}
+		}
+		// Filter types 0, 1, 2 and 4 of the PNG specification.
+		filtered.push_back((unsigned char)(best == 3 ? 4 : best));
+		filtered.insert(filtered.end(), candidates[best].begin(), candidates[best].end());
+	}
+
+	out_png.clear();
+	static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	out_png.insert(out_png.end(), signature, signature + 8);
+	std::vector<unsigned char> header;
+	put32(header, (uint32_t)width);
+	put32(header, (uint32_t)height);
+	// 8 bits per channel, RGBA, deflate, adaptive filtering, no interlace.
+	header.insert(header.end(), { 8, 6, 0, 0, 0 });
+	chunk(out_png, "IHDR", header.data(), header.size());
+	std::vector<unsigned char> compressed;
+	deflate(filtered, compressed);
+	chunk(out_png, "IDAT", compressed.data(), compressed.size());
+	chunk(out_png, "IEND", nullptr, 0);
+}
+
+bool writePng(const char * path, int width, int height, const unsigned char * rgba)
+{
+	std::vector<unsigned char> png;
+	encodePng(width, height, rgba, png);
+	FILE* file = fopen(path, "wb");
+	if (!file)
+		return false;
+	bool ok = fwrite(png.data(), 1, png.size(), file) == png.size();
+	return fclose(file) == 0 && ok;
+}
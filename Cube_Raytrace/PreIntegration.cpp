@@ -0,0 +1,118 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "parallel.hpp"
+#include "preintegration.hpp"
+#include "renderer.hpp"
+
+void buildTransferFunction(const unsigned char * colormap, int colormapWidth, float opacityCutoff, int size, TransferFunction & out)
+{
+	out.rgba.resize((size_t)size * 4);
+	for (int i = 0; i < size; i++)
+	{
+		float v = (float)i / (size - 1);
+		float x = std::min(std::max(v * colormapWidth - 0.5f, 0.0f), (float)(colormapWidth - 1));
+		int x0 = (int)x;
+		int x1 = std::min(x0 + 1, colormapWidth - 1);
+		float f = x - x0;
+		for (int c = 0; c < 3; c++)
+			out.rgba[i * 4 + c] = ((1.0f - f) * colormap[x0 * 4 + c] + f * colormap[x1 * 4 + c]) / 255.0f;
+		out.rgba[i * 4 + 3] = v >= opacityCutoff ? v : 0.0f;
+	}
+}
+
+// Transfer function at a fractional entry index.
+static void lookup(const TransferFunction & tf, float x, float rgba[4])
+{
+	int x0 = std::min((int)x, tf.size() - 1);
+	int x1 = std::min(x0 + 1, tf.size() - 1);
+	float f = x - x0;
+	for (int c = 0; c < 4; c++)
+		rgba[c] = (1.0f - f) * tf.rgba[x0 * 4 + c] + f * tf.rgba[x1 * 4 + c];
+}
+
+static void integrate(const TransferFunction & tf, int front, int back, float * out)
+{
+	int steps = std::max(1, std::abs(back - front));
+	float color[3] = { 0.0f, 0.0f, 0.0f };
+	float alpha = 0.0f;
+	for (int k = 0; k < steps; k++)
+	{
+		float rgba[4];
+		lookup(tf, front + (back - front) * (k + 0.5f) / steps, rgba);
+		float a = 1.0f - std::pow(1.0f - std::min(rgba[3], 0.9999f), 1.0f / steps);
+		for (int c = 0; c < 3; c++)
+			color[c] += (1.0f - alpha) * a * rgba[c];
+		alpha += (1.0f - alpha) * a;
+	}
+	out[0] = color[0];
+	out[1] = color[1];
+	out[2] = color[2];
+	out[3] = alpha;
+}
+
+PreIntegrationTable::PreIntegrationTable()
+{
+	GLCall(glGenTextures(1, &m_Texture));
+	GLCall(glBindTexture(GL_TEXTURE_2D, m_Texture));
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+	GLCall(glBindTexture(GL_TEXTURE_2D, 0));
+}
+
+PreIntegrationTable::~PreIntegrationTable()
+{
+	GLCall(glDeleteTextures(1, &m_Texture));
+}
+
+size_t PreIntegrationTable::update(const TransferFunction & tf)
+{
+	auto start = std::chrono::steady_clock::now();
+	int n = tf.size();
+	bool full = n != m_Size;
+
+	// Span of entries that differ; interpolation reaches one entry further.
+	int lo = 0, hi = n - 1;
+	if (!full) {
+		lo = n;
+		hi = -1;
+		for (int i = 0; i < n; i++)
+			for (int c = 0; c < 4; c++)
+				if (tf.rgba[i * 4 + c] != m_Built.rgba[i * 4 + c]) {
+					lo = std::min(lo, i);
+					hi = std::max(hi, i);
+				}
+		if (hi < 0)
+			return 0;
+		lo = std::max(0, lo - 1);
+		hi = std::min(n - 1, hi + 1);
+	}
+	m_Size = n;
+	m_Built = tf;
+	m_Table.resize((size_t)n * n * 4);
+
+	// Entry (front, back) integrates the values between the two.
+	std::vector<size_t> counts(parallelChunkCount(n, 1), 0);
+	parallelFor(0, n, 1, [&](size_t bb, size_t be, size_t chunk) {
+		for (int back = (int)bb; back < (int)be; back++)
+			for (int front = 0; front < n; front++)
+			{
+				if (std::max(front, back) < lo || std::min(front, back) > hi)
+					continue;
+				integrate(tf, front, back, &m_Table[((size_t)back * n + front) * 4]);
+				counts[chunk]++;
+			}
+	});
+	size_t count = 0;
+	for (size_t c : counts)
+		count += c;
+
+	GLCall(glBindTexture(GL_TEXTURE_2D, m_Texture));
+	GLCall(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, n, n, 0, GL_RGBA, GL_FLOAT, m_Table.data()));
+	GLCall(glBindTexture(GL_TEXTURE_2D, 0));
+	m_LastBuildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return count;
+}
@@ -0,0 +1,142 @@
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+#include "programcache.hpp"
+#include "renderer.hpp"
+
+struct ProgramBinaryHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t key;
+	uint32_t format;
+	uint32_t length;
+};
+
+static const uint32_t kProgramBinaryVersion = 1;
+static const char * kProgramCacheDir = "shadercache";
+static bool s_CacheEnabled = true;
+
+static uint64_t fnv1a(const void * data, size_t size, uint64_t hash)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+uint64_t programCacheKey(const std::vector<std::string>& sources)
+{
+	uint64_t hash = 14695981039346656037ull;
+	// The terminating zero keeps ("ab", "c") and ("a", "bc") apart.
+	for (const std::string& source : sources)
+		hash = fnv1a(source.c_str(), source.size() + 1, hash);
+	const GLenum names[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+	for (GLenum name : names)
+	{
+		GLCall(const char* value = (const char*)glGetString(name));
+		if (value != NULL)
+			hash = fnv1a(value, strlen(value) + 1, hash);
+	}
+	return hash;
+}
+
+std::string programCachePath(const std::string& filepath, const std::vector<std::string>& defines)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (const std::string& define : defines)
+		hash = fnv1a(define.c_str(), define.size() + 1, hash);
+	size_t slash = filepath.find_last_of("/\\");
+	std::string name = slash == std::string::npos ? filepath : filepath.substr(slash + 1);
+	char hex[17];
+	snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)hash);
+	return std::string(kProgramCacheDir) + "/" + name + "." + hex + ".bin";
+}
+
+void setProgramCacheEnabled(bool enabled)
+{
+	s_CacheEnabled = enabled;
+}
+
+bool programCacheAvailable()
+{
+	if (!s_CacheEnabled || !(GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary))
+		return false;
+	GLint formats = 0;
+	GLCall(glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats));
+	return formats > 0;
+}
+
+bool loadProgramBinary(const std::string& path, uint64_t key, unsigned int program)
+{
+	FILE* file = fopen(path.c_str(), "rb");
+	if (file == NULL)
+		return false;
+
+	ProgramBinaryHeader header;
+	std::vector<char> binary;
+	bool valid = fread(&header, sizeof(header), 1, file) == 1
+		&& memcmp(header.magic, "GLPB", 4) == 0
+		&& header.version == kProgramBinaryVersion
+		&& header.key == key
+		&& header.length > 0;
+	if (valid) {
+		binary.resize(header.length);
+		valid = fread(binary.data(), 1, binary.size(), file) == binary.size();
+	}
+	fclose(file);
+	if (!valid)
+		return false;
+
+	// A driver may reject its own binaries, e.g. after an update that keeps
+	// the version string; the caller then links from source.
+	GLCall(glProgramBinary(program, header.format, binary.data(), (GLsizei)binary.size()));
+	GLint linked = GL_FALSE;
+	GLCall(glGetProgramiv(program, GL_LINK_STATUS, &linked));
+	return linked == GL_TRUE;
+}
+
+bool saveProgramBinary(const std::string& path, uint64_t key, unsigned int program)
+{
+	GLint length = 0;
+	GLCall(glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length));
+	if (length <= 0)
+		return false;
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	GLCall(glGetProgramBinary(program, length, &length, &format, binary.data()));
+
+	ProgramBinaryHeader header = {};
+	memcpy(header.magic, "GLPB", 4);
+	header.version = kProgramBinaryVersion;
+	header.key = key;
+	header.format = format;
+	header.length = (uint32_t)length;
+
+	// Fails harmlessly when the directory is already there.
+#ifdef _WIN32
+	_mkdir(kProgramCacheDir);
+#else
+	mkdir(kProgramCacheDir, 0755);
+#endif
+	FILE* file = fopen(path.c_str(), "wb");
+	if (file == NULL) {
+		printf("Impossible to write %s\n", path.c_str());
+		return false;
+	}
+	bool written = fwrite(&header, sizeof(header), 1, file) == 1
+		&& fwrite(binary.data(), 1, (size_t)length, file) == (size_t)length;
+	fclose(file);
+	if (!written) {
+		printf("Impossible to write %s\n", path.c_str());
+		remove(path.c_str());
+	}
+	return written;
+}
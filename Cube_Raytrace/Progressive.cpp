@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <cmath>
+
+#include "progressive.hpp"
+#include "renderer.hpp"
+#include "shaderprogram.hpp"
+
+ProgressiveRenderer::ProgressiveRenderer()
+{
+	GLCall(glGenFramebuffers(1, &m_PassFramebuffer));
+	GLCall(glGenTextures(1, &m_PassColor));
+	GLCall(glGenRenderbuffers(1, &m_PassDepth));
+	GLCall(glGenFramebuffers(1, &m_AccumFramebuffer));
+	GLCall(glGenTextures(1, &m_AccumColor));
+	m_Present = new ShaderProgram("res/shader/Present.shader");
+}
+
+ProgressiveRenderer::~ProgressiveRenderer()
+{
+	delete m_Present;
+	GLCall(glDeleteFramebuffers(1, &m_PassFramebuffer));
+	GLCall(glDeleteTextures(1, &m_PassColor));
+	GLCall(glDeleteRenderbuffers(1, &m_PassDepth));
+	GLCall(glDeleteFramebuffers(1, &m_AccumFramebuffer));
+	GLCall(glDeleteTextures(1, &m_AccumColor));
+}
+
+static void allocateColor(unsigned int id, GLenum internalFormat, int width, int height)
+{
+	GLCall(glBindTexture(GL_TEXTURE_2D, id));
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+	GLCall(glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, GL_RGBA, GL_FLOAT, nullptr));
+	GLCall(glBindTexture(GL_TEXTURE_2D, 0));
+}
+
+void ProgressiveRenderer::allocate(int width, int height)
+{
+	m_Width = width;
+	m_Height = height;
+	allocateColor(m_PassColor, GL_RGBA16F, width, height);
+	// Averages of many passes need more than half-float precision.
+	allocateColor(m_AccumColor, GL_RGBA32F, width, height);
+	GLCall(glBindRenderbuffer(GL_RENDERBUFFER, m_PassDepth));
+	GLCall(glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height));
+	GLCall(glBindRenderbuffer(GL_RENDERBUFFER, 0));
+
+	GLCall(glBindFramebuffer(GL_FRAMEBUFFER, m_PassFramebuffer));
+	GLCall(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_PassColor, 0));
+	GLCall(glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_PassDepth));
+	GLCall(GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER));
+	ASSERT(status == GL_FRAMEBUFFER_COMPLETE);
+	GLCall(glBindFramebuffer(GL_FRAMEBUFFER, m_AccumFramebuffer));
+	GLCall(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_AccumColor, 0));
+	GLCall(status = glCheckFramebufferStatus(GL_FRAMEBUFFER));
+	ASSERT(status == GL_FRAMEBUFFER_COMPLETE);
+	GLCall(glClearColor(0.0f, 0.0f, 0.0f, 0.0f));
+	GLCall(glClear(GL_COLOR_BUFFER_BIT));
+	GLCall(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+}
+
+bool ProgressiveRenderer::beginFrame(int width, int height, bool moving, bool reset, double frameMs)
+{
+	if (width != m_Width || height != m_Height) {
+		allocate(width, height);
+		reset = true;
+	}
+	if (!enabled || moving) {
+		if (dynamicScale > 0.0f) {
+			m_Scale = dynamicScale;
+			m_StepFactor = dynamicStepFactor;
+		}
+		else if (enabled) {
+			if (m_Interactive && frameMs > interactiveBudgetMs)
+				m_InteractiveDivisor = 4;
+			else if (m_Interactive && frameMs < 0.5 * interactiveBudgetMs)
+				m_InteractiveDivisor = 2;
+			m_Scale = 1.0f / m_InteractiveDivisor;
+			m_StepFactor = 2.0f;
+		}
+		else {
+			m_Scale = 1.0f;
+			m_StepFactor = 1.0f;
+		}
+		m_PassWidth = std::max((int)(m_Width * m_Scale + 0.5f), 1);
+		m_PassHeight = std::max((int)(m_Height * m_Scale + 0.5f), 1);
+		m_Interactive = true;
+		m_Jitter = -1.0f;
+		m_Passes = 0;
+		m_Drawing = true;
+		return true;
+	}
+	if (m_Interactive && m_Drawing) {
+		// Rows the first pass has not reached yet show the last
+		// interactive image.
+		GLCall(glBindFramebuffer(GL_READ_FRAMEBUFFER, m_PassFramebuffer));
+		GLCall(glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_AccumFramebuffer));
+		GLCall(glBlitFramebuffer(0, 0, m_PassWidth, m_PassHeight, 0, 0, m_Width, m_Height, GL_COLOR_BUFFER_BIT, GL_LINEAR));
+		GLCall(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+	}
+	if (reset || m_Interactive) {
+		m_Passes = 0;
+		m_StripY = 0;
+	}
+	m_Interactive = false;
+	m_Scale = 1.0f;
+	m_StepFactor = 1.0f;
+	m_PassWidth = m_Width;
+	m_PassHeight = m_Height;
+	m_Drawing = m_Passes < maxPasses;
+	// Strips are sized for the budget again every frame, at least 8 rows
+	// so a badly overrunning pass still finishes.
+	int rows = m_Height;
+	if (passBudgetMs > 0.0 && passCostMs > passBudgetMs)
+		rows = std::max((int)(m_Height * passBudgetMs / passCostMs), 8);
+	m_StripRows = std::min(rows, m_Height - m_StripY);
+	// Golden-ratio sequence: evenly spread offsets for any number of passes.
+	m_Jitter = (float)std::fmod(0.5 + m_Passes * 0.6180339887498949, 1.0);
+	return m_Drawing;
+}
+
+void ProgressiveRenderer::bindTarget() const
+{
+	GLCall(glBindFramebuffer(GL_FRAMEBUFFER, m_PassFramebuffer));
+	GLCall(glViewport(0, 0, m_PassWidth, m_PassHeight));
+	// Stays set until endFrame, so everything drawn for the pass is clipped
+	// to the strip.
+	if (!m_Interactive && m_StripRows < m_Height) {
+		GLCall(glEnable(GL_SCISSOR_TEST));
+		GLCall(glScissor(0, m_StripY, m_Width, m_StripRows));
+	}
+}
+
+void ProgressiveRenderer::endFrame(unsigned int quadVao, unsigned int target)
+{
+	if (!m_Interactive && m_Drawing) {
+		// Running average: the n-th pass weighs 1 / n. Strips of a pass
+		// all weigh the same, and the pass counts once the last is drawn.
+		bool strip = m_StripRows < m_Height;
+		GLCall(GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST));
+		GLCall(glDisable(GL_DEPTH_TEST));
+		GLCall(glBindFramebuffer(GL_FRAMEBUFFER, m_AccumFramebuffer));
+		GLCall(glViewport(0, 0, m_Width, m_Height));
+		GLCall(glEnable(GL_BLEND));
+		GLCall(glBlendColor(0.0f, 0.0f, 0.0f, 1.0f / (m_Passes + 1)));
+		GLCall(glBlendFunc(GL_CONSTANT_ALPHA, GL_ONE_MINUS_CONSTANT_ALPHA));
+		m_Present->Bind();
+		GLCall(glActiveTexture(GL_TEXTURE0));
+		GLCall(glBindTexture(GL_TEXTURE_2D, m_PassColor));
+		m_Present->SetUniform1i("u_Image", 0);
+		GLCall(glBindVertexArray(quadVao));
+		GLCall(glDrawArrays(GL_TRIANGLES, 0, 6));
+		if (strip) {
+			GLCall(glDisable(GL_SCISSOR_TEST));
+		}
+		m_StripY += m_StripRows;
+		if (m_StripY >= m_Height) {
+			m_StripY = 0;
+			m_Passes++;
+		}
+		if (depthTest) {
+			GLCall(glEnable(GL_DEPTH_TEST));
+		}
+	}
+	present(target);
+}
+
+void ProgressiveRenderer::present(unsigned int target) const
+{
+	unsigned int source = m_Interactive ? m_PassFramebuffer : m_AccumFramebuffer;
+	int sourceWidth = m_Interactive ? m_PassWidth : m_Width;
+	int sourceHeight = m_Interactive ? m_PassHeight : m_Height;
+	GLCall(glBindFramebuffer(GL_READ_FRAMEBUFFER, source));
+	GLCall(glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target));
+	GLCall(glBlitFramebuffer(0, 0, sourceWidth, sourceHeight, 0, 0, m_Width, m_Height, GL_COLOR_BUFFER_BIT, GL_LINEAR));
+	GLCall(glBindFramebuffer(GL_FRAMEBUFFER, target));
+	GLCall(glViewport(0, 0, m_Width, m_Height));
+}
@@ -0,0 +1,156 @@
+#include <algorithm>
+
+#include "raysetup.hpp"
+#include "renderer.hpp"
+
+static void allocateTarget(unsigned int id, int width, int height)
+{
+	GLCall(glBindTexture(GL_TEXTURE_2D, id));
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+	GLCall(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+	GLCall(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, nullptr));
+}
+
+RaySetup::RaySetup()
+{
+	GLCall(glGenFramebuffers(1, &m_Framebuffer));
+	GLCall(glGenTextures(1, &m_Entry));
+	GLCall(glGenTextures(1, &m_Exit));
+	GLCall(glGenRenderbuffers(1, &m_Depth));
+	GLCall(glGenVertexArrays(1, &m_Vao));
+	GLCall(glGenBuffers(1, &m_Vbo));
+	GLCall(glBindVertexArray(m_Vao));
+	GLCall(glBindBuffer(GL_ARRAY_BUFFER, m_Vbo));
+	GLCall(glEnableVertexAttribArray(0));
+	GLCall(glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0));
+	GLCall(glBindVertexArray(0));
+}
+
+RaySetup::~RaySetup()
+{
+	GLCall(glDeleteFramebuffers(1, &m_Framebuffer));
+	GLCall(glDeleteTextures(1, &m_Entry));
+	GLCall(glDeleteTextures(1, &m_Exit));
+	GLCall(glDeleteRenderbuffers(1, &m_Depth));
+	GLCall(glDeleteVertexArrays(1, &m_Vao));
+	GLCall(glDeleteBuffers(1, &m_Vbo));
+}
+
+void RaySetup::setGeometry(const std::vector<float> & positions)
+{
+	GLCall(glBindBuffer(GL_ARRAY_BUFFER, m_Vbo));
+	GLCall(glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(float), positions.data(), GL_STATIC_DRAW));
+	GLCall(glBindBuffer(GL_ARRAY_BUFFER, 0));
+	m_VertexCount = (int)(positions.size() / 3);
+}
+
+void RaySetup::resize(int width, int height)
+{
+	if (width == m_Width && height == m_Height)
+		return;
+	m_Width = width;
+	m_Height = height;
+	allocateTarget(m_Entry, width, height);
+	allocateTarget(m_Exit, width, height);
+	GLCall(glBindTexture(GL_TEXTURE_2D, 0));
+	GLCall(glBindRenderbuffer(GL_RENDERBUFFER, m_Depth));
+	GLCall(glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height));
+	GLCall(glBindRenderbuffer(GL_RENDERBUFFER, 0));
+
+	GLCall(glBindFramebuffer(GL_FRAMEBUFFER, m_Framebuffer));
+	GLCall(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_Entry, 0));
+	GLCall(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, m_Exit, 0));
+	GLCall(glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_Depth));
+	GLCall(GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER));
+	ASSERT(status == GL_FRAMEBUFFER_COMPLETE);
+	GLCall(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+}
+
+void RaySetup::render(unsigned int program, const float * model)
+{
+	GLCall(GLboolean blend = glIsEnabled(GL_BLEND));
+	GLCall(glDisable(GL_BLEND));
+	GLCall(glEnable(GL_DEPTH_TEST));
+	GLCall(glBindFramebuffer(GL_FRAMEBUFFER, m_Framebuffer));
+	GLCall(glViewport(0, 0, m_Width, m_Height));
+	GLCall(glUseProgram(program));
+	GLCall(glUniformMatrix4fv(glGetUniformLocation(program, "model"), 1, GL_FALSE, model));
+	GLCall(glBindVertexArray(m_Vao));
+	GLCall(glClearColor(0.0f, 0.0f, 0.0f, 0.0f));
+
+	// Entry: nearest surface.
+	GLCall(glDrawBuffer(GL_COLOR_ATTACHMENT0));
+	GLCall(glClearDepth(1.0));
+	GLCall(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
+	GLCall(glDepthFunc(GL_LESS));
+	GLCall(glDrawArrays(GL_TRIANGLES, 0, m_VertexCount));
+
+	// Exit: farthest surface.
+	GLCall(glDrawBuffer(GL_COLOR_ATTACHMENT1));
+	GLCall(glClearDepth(0.0));
+	GLCall(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
+	GLCall(glDepthFunc(GL_GREATER));
+	GLCall(glDrawArrays(GL_TRIANGLES, 0, m_VertexCount));
+
+	GLCall(glDepthFunc(GL_LESS));
+	GLCall(glClearDepth(1.0));
+	GLCall(glBindVertexArray(0));
+	GLCall(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+	if (blend) {
+		GLCall(glEnable(GL_BLEND));
+	}
+}
+
+void buildProxyGeometry(
+	const MacroCellGrid & grid,
+	const int volumeDims[3],
+	float threshold,
+	const float boxMin[3],
+	const float boxSize[3],
+	std::vector<float> & out_positions
+) {
+	out_positions.clear();
+	const int* dims = grid.dims;
+	auto visible = [&](int x, int y, int z) {
+		if (x < 0 || y < 0 || z < 0 || x >= dims[0] || y >= dims[1] || z >= dims[2])
+			return false;
+		return grid.minMax[(((size_t)z * dims[1] + y) * dims[0] + x) * 2 + 1] > threshold;
+	};
+	// Object-space coordinate of cell boundary i along axis a.
+	auto boundary = [&](int a, int i) {
+		float v = (float)std::min(i * grid.cellSize, volumeDims[a]) / volumeDims[a];
+		return boxMin[a] + v * boxSize[a];
+	};
+	for (int z = 0; z < dims[2]; z++)
+		for (int y = 0; y < dims[1]; y++)
+			for (int x = 0; x < dims[0]; x++)
+			{
+				if (!visible(x, y, z))
+					continue;
+				int cell[3] = { x, y, z };
+				for (int axis = 0; axis < 3; axis++)
+					for (int side = 0; side < 2; side++)
+					{
+						int neighbour[3] = { x, y, z };
+						neighbour[axis] += side ? 1 : -1;
+						if (visible(neighbour[0], neighbour[1], neighbour[2]))
+							continue;
+						// Quad on the plane axis = cell + side spanning the other two axes.
+						int u = (axis + 1) % 3, v = (axis + 2) % 3;
+						float plane = boundary(axis, cell[axis] + side);
+						float u0 = boundary(u, cell[u]), u1 = boundary(u, cell[u] + 1);
+						float v0 = boundary(v, cell[v]), v1 = boundary(v, cell[v] + 1);
+						const float corners[6][2] = { { u0, v0 }, { u1, v0 }, { u1, v1 }, { u0, v0 }, { u1, v1 }, { u0, v1 } };
+						for (int c = 0; c < 6; c++)
+						{
+							float p[3];
+							p[axis] = plane;
+							p[u] = corners[c][0];
+							p[v] = corners[c][1];
+							out_positions.insert(out_positions.end(), p, p + 3);
+						}
+					}
+			}
+}
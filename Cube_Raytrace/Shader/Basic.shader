@@ -28,6 +28,197 @@ layout(location = 0) out vec4 u_Color;
 uniform sampler2D colormap;
 uniform sampler3D u_Texture;
 uniform vec3 volume_dims;
+// Window/level in texture units: val = (sample - low) * scale
+uniform float u_WindowLow;
+uniform float u_WindowScale;
+// Out-of-core mode: u_Texture is the brick atlas and u_PageTable holds,
+// per brick, its atlas slot (xyz) and whether it is resident (w).
+uniform bool u_Paged;
+uniform usampler3D u_PageTable;
+uniform vec3 u_BrickGrid;
+uniform float u_BrickSize;
+uniform float u_BrickApron;
+uniform float u_AtlasSize;
+// Level of detail: the sample footprint is the larger of the step and the
+// pixel footprint u_LodFootprint, both in volume coordinates. The
+// projection is orthographic, so the pixel footprint is the same at every
+// depth. u_MaxLod is 0 when the texture has no mip levels.
+uniform float u_MaxLod;
+uniform float u_LodBias;
+uniform float u_LodFootprint;
+// Empty-space skipping: 0 off, 1 per macro-cell (min/max in texture units),
+// 2 through the Chebyshev distance field over the same cells.
+uniform int u_SkipMode;
+uniform sampler3D u_MacroCells;
+uniform usampler3D u_DistanceField;
+uniform vec3 u_CellGrid;
+uniform float u_CellSize;
+// Rasterized ray setup: per-pixel entry and exit points in volume
+// coordinates, alpha 0 where the bounding geometry does not cover the pixel.
+uniform bool u_RaySetup;
+uniform sampler2D u_EntryPoints;
+uniform sampler2D u_ExitPoints;
+// Progressive refinement: window pixels per fragment of the pass (the
+// entry and exit points stay at window resolution), and the offset of the
+// first sample in steps, varied per pixel; negative to start on the entry.
+uniform float u_FragScale;
+uniform float u_Jitter;
+// Steps are in voxels along the ray; adaptive stepping varies them between
+// u_MinStepScale and u_MaxStepScale.
+uniform float u_StepScale;
+uniform bool u_AdaptiveStep;
+uniform float u_MinStepScale;
+uniform float u_MaxStepScale;
+uniform float u_GradientSensitivity;
+// Opacity is the windowed value from u_OpacityCutoff up, 0 below it.
+uniform float u_OpacityCutoff;
+// Pre-integrated compositing: u_PreIntegration(front, back) is the
+// premultiplied color and opacity of one voxel of ray between two
+// consecutive samples.
+uniform sampler2D u_PreIntegration;
+uniform float u_PreIntegrationSize;
+// Phong lighting as in the lighting demos, laid out as LightingBlock in
+// lighting.hpp. Only samples more opaque than u_ShadingThreshold are lit.
+layout(std140) uniform Lighting
+{
+	vec4 u_LightPosition;
+	vec4 u_LightColor;
+	float u_Ambient;
+	float u_SpecularStrength;
+	float u_Shininess;
+	float u_ShadingThreshold;
+	int u_Shading;
+};
+// Render mode, compiled in as one permutation each: RENDER_COMPOSITE (the
+// default), RENDER_MIP, RENDER_MINIP, RENDER_AVERAGE or RENDER_ISOSURFACE.
+#if !defined(RENDER_COMPOSITE) && !defined(RENDER_MIP) && !defined(RENDER_MINIP) && !defined(RENDER_AVERAGE) && !defined(RENDER_ISOSURFACE)
+#define RENDER_COMPOSITE
+#endif
+// Composite accumulation, one permutation each as well:
+// COMPOSITE_FRONT_TO_BACK "over" with opacity corrected for the step length
+// (the default), COMPOSITE_PREINTEGRATED over pre-integrated segments, or
+// COMPOSITE_LEGACY, which adds colors and opacities as they come.
+// First-hit isosurface: the windowed value the surface is drawn at, and
+// the number of bisection steps that refine a crossing between samples.
+uniform float u_IsoValue;
+uniform int u_RefineSteps;
+
+float sampleLod(float dt)
+{
+	float footprint = max(dt, u_LodFootprint) * max(volume_dims.x, max(volume_dims.y, volume_dims.z));
+	return clamp(log2(max(footprint, 1.0)) + u_LodBias, 0.0, u_MaxLod);
+}
+
+float sampleVolume(vec3 p, float lod)
+{
+	if (!u_Paged)
+		return textureLod(u_Texture, p, lod).r;
+	vec3 voxel = clamp(p, 0.0, 1.0) * volume_dims;
+	vec3 brick = min(floor(voxel / u_BrickSize), u_BrickGrid - 1.0);
+	uvec4 entry = texelFetch(u_PageTable, ivec3(brick), 0);
+	// Bricks that are not resident are treated as empty.
+	if (entry.w == 0u)
+		return u_WindowLow;
+	vec3 local = voxel - brick * u_BrickSize + u_BrickApron;
+	vec3 atlas = vec3(entry.xyz) * (u_BrickSize + 2.0 * u_BrickApron) + local;
+	return textureLod(u_Texture, atlas / u_AtlasSize, 0.0).r;
+}
+
+float sampleWindowed(vec3 p, float lod)
+{
+	return clamp((sampleVolume(p, lod) - u_WindowLow) * u_WindowScale, 0.0, 1.0);
+}
+
+#if defined(GRADIENT_PRECOMPUTED)
+// Precomputed gradients relative to u_GradientMax (texture units): unit
+// direction in rgb and magnitude in alpha when u_GradientNormalized, else
+// the gradient itself in rgb.
+uniform sampler3D u_Gradients;
+uniform bool u_GradientNormalized;
+uniform float u_GradientMax;
+#endif
+
+// Central differences one voxel apart, pointing towards higher values.
+vec3 gradientAt(vec3 p, float lod)
+{
+#if defined(GRADIENT_PRECOMPUTED)
+	vec4 packed = textureLod(u_Gradients, p, 0.0);
+	vec3 g = packed.rgb * 2.0 - 1.0;
+	if (u_GradientNormalized)
+		g = (dot(g, g) > 0.0 ? normalize(g) : g) * packed.a;
+	return g * u_GradientMax * u_WindowScale;
+#else
+	vec3 h = 1.0 / volume_dims;
+	return vec3(
+		sampleVolume(p + vec3(h.x, 0.0, 0.0), lod) - sampleVolume(p - vec3(h.x, 0.0, 0.0), lod),
+		sampleVolume(p + vec3(0.0, h.y, 0.0), lod) - sampleVolume(p - vec3(0.0, h.y, 0.0), lod),
+		sampleVolume(p + vec3(0.0, 0.0, h.z), lod) - sampleVolume(p - vec3(0.0, 0.0, h.z), lod)) * u_WindowScale;
+#endif
+}
+
+// Diffuse (floored at the ambient level) plus specular; the surface faces
+// the viewer, the normal pointing away from higher values.
+vec3 phong(vec3 p, vec3 ray_dir, float lod)
+{
+	vec3 grad = gradientAt(p, lod);
+	if (dot(grad, grad) == 0.0)
+		return vec3(1.0);
+	vec3 norm = -normalize(grad);
+	vec3 viewDir = -ray_dir;
+	if (dot(norm, viewDir) < 0.0)
+		norm = -norm;
+	vec3 lightDir = normalize(u_LightPosition.xyz - p);
+	float diff = max(dot(norm, lightDir), u_Ambient);
+	vec3 reflectDir = reflect(-lightDir, norm);
+	float spec = u_SpecularStrength * pow(max(dot(viewDir, reflectDir), 0.0), u_Shininess);
+	return (diff + spec) * u_LightColor.rgb;
+}
+
+// Lighting factor of a sample; the gradient is only taken for visible ones.
+vec3 shadeSample(vec3 p, vec3 ray_dir, float lod, float opacity)
+{
+	if (u_Shading == 0 || opacity <= u_ShadingThreshold)
+		return vec3(1.0);
+	return phong(p, ray_dir, lod);
+}
+
+// A cell is empty when nothing in it maps above zero opacity, or for the
+// isosurface when nothing in it reaches the isovalue.
+bool cellVisible(vec2 range)
+{
+#if defined(RENDER_ISOSURFACE)
+	return range.y > u_WindowLow + u_IsoValue / u_WindowScale;
+#else
+	return range.y > u_WindowLow;
+#endif
+}
+
+// Distance along dir from p (inside) to the boundary of the cells
+// [cellMin, cellMax).
+float cellsExit(vec3 p, vec3 dir, vec3 cellMin, vec3 cellMax)
+{
+	vec3 bound = mix(cellMin, cellMax, step(0.0, dir)) * u_CellSize / volume_dims;
+	vec3 safeDir = mix(vec3(1e-6), dir, greaterThan(abs(dir), vec3(1e-6)));
+	vec3 tAxis = (bound - p) / safeDir;
+	return max(min(tAxis.x, min(tAxis.y, tAxis.z)), 0.0);
+}
+
+// Distance along dir that is known to be empty from p on: the rest of p's
+// macro-cell, or with the distance field the rest of the empty cube of
+// cells around it. 0 when p's cell is visible or p lies outside the volume.
+float emptySkip(vec3 p, vec3 dir)
+{
+	if (any(lessThan(p, vec3(0.0))) || any(greaterThanEqual(p, vec3(1.0))))
+		return 0.0;
+	vec3 cell = min(floor(p * volume_dims / u_CellSize), u_CellGrid - 1.0);
+	if (u_SkipMode == 2) {
+		float d = float(texelFetch(u_DistanceField, ivec3(cell), 0).r);
+		return d == 0.0 ? 0.0 : cellsExit(p, dir, cell - (d - 1.0), cell + d);
+	}
+	if (cellVisible(texelFetch(u_MacroCells, ivec3(cell), 0).rg))
+		return 0.0;
+	return cellsExit(p, dir, cell, cell + 1.0);
+}
 
 vec2 intersect_box(vec3 orig, vec3 dir)
 {
@@ -47,44 +238,187 @@ vec2 intersect_box(vec3 orig, vec3 dir)
 void main()
 {
 
-	// Step 1: Normalize the view ray
-	vec3 ray_dir = normalize(vray_dir);
+	vec3 ray_origin = eye;
+	vec3 ray_dir;
+	vec2 t_hit;
+	if (u_RaySetup) {
+		// Entry and exit come from the rasterized bounding geometry.
+		ivec2 pixel = ivec2(gl_FragCoord.xy * u_FragScale);
+		vec4 entry = texelFetch(u_EntryPoints, pixel, 0);
+		vec4 exit = texelFetch(u_ExitPoints, pixel, 0);
+		float len = length(exit.xyz - entry.xyz);
+		if (entry.a == 0.0 || exit.a == 0.0 || len == 0.0)
+			discard;
+		ray_origin = entry.xyz;
+		ray_dir = (exit.xyz - entry.xyz) / len;
+		t_hit = vec2(0.0, len);
+	}
+	else {
+		// Step 1: Normalize the view ray
+		ray_dir = normalize(vray_dir);
 
-	// Step 2: Intersect the ray with the volume bounds to find the interval
-	// along the ray overlapped by the volume.
-	vec2 t_hit = intersect_box(eye, ray_dir);
-	if (t_hit.x > t_hit.y) {
-		discard;
+		// Step 2: Intersect the ray with the volume bounds to find the interval
+		// along the ray overlapped by the volume.
+		t_hit = intersect_box(eye, ray_dir);
+		if (t_hit.x > t_hit.y) {
+			discard;
+		}
 	}
 	// We don't want to sample voxels behind the eye if it's
 	// inside the volume, so keep the starting point at or in front
 	// of the eye
 	t_hit.x = max(t_hit.x, 0.0);
 
-	// Step 3: Compute the step size to march through the volume grid
-	vec3 dt_vec =(vec3(128) * abs(ray_dir));
-	float dt = min(dt_vec.x, min(dt_vec.y, dt_vec.z));
+	// Step 3: Compute the step size to march through the volume grid: one
+	// voxel along the axis the ray crosses voxels fastest, scaled.
+	vec3 dt_vec = 1.0 / (volume_dims * abs(ray_dir));
+	float dt_voxel = min(dt_vec.x, min(dt_vec.y, dt_vec.z));
+	float dt = u_StepScale * dt_voxel;
 	// Step 4: Starting from the entry point, march the ray through the volume
 	// and sample it
-	vec3 p = eye + ray_dir * ( t_hit.y);
-	for (float t = t_hit.x; t <= t_hit.y; t += dt) {
+	u_Color = vec4(0.0);
+	float prev_val = -1.0;
+	float seg_dt = dt;
+	float prev_t = t_hit.x;
+#if defined(RENDER_MIP)
+	float max_val = 0.0;
+#elif defined(RENDER_MINIP)
+	float min_val = 1.0;
+#elif defined(RENDER_AVERAGE)
+	float sum_val = 0.0;
+#endif
+	float t = t_hit.x;
+	if (u_Jitter >= 0.0) {
+		// Interleaved gradient noise keeps neighbouring pixels apart, the pass
+		// offset moves all of them between passes.
+		float noise = fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+		t += fract(noise + u_Jitter) * dt;
+		prev_t = t;
+	}
+	while (t <= t_hit.y) {
+		vec3 p = ray_origin + ray_dir * t;
+#if !defined(RENDER_MINIP)
+		// Jump past empty space. With a fixed step the jump is a whole number
+		// of steps so the remaining samples stay where they would have been.
+		// Empty space is all zeros, so it only matters to the minimum.
+		if (u_SkipMode != 0) {
+			float skip = emptySkip(p, ray_dir);
+			if (skip > 0.0) {
+				prev_t = t + skip;
+#if defined(RENDER_COMPOSITE)
+				t += u_AdaptiveStep ? skip + 1e-4 * dt_voxel : max(ceil(skip / dt), 1.0) * dt;
+#elif defined(RENDER_ISOSURFACE)
+				// Bisection finds the surface, so samples need not stay aligned.
+				t += skip + 1e-4 * dt_voxel;
+#else
+				t += max(ceil(skip / dt), 1.0) * dt;
+#endif
+				prev_val = 0.0;
+				seg_dt = dt;
+				continue;
+			}
+		}
+#endif
 		// Step 4.1: Sample the volume, and color it by the transfer function.
-		// Note that here we don't use the opacity from the transfer function,
-		// and just use the sample value as the opacity
-		float val = texture(u_Texture, p).r;
-		vec4 val_color = vec4(texture(colormap, vec2(val, 0.5)).rgb, val);
-
-		// Step 4.2: Accumulate the color and opacity using the front-to-back
-		// compositing equation
-		u_Color.rgb += val_color.rgb;
-		u_Color.a +=  val_color.a;
-		
+		// The sample value is used as the opacity of one voxel's worth of ray.
+		float lod = sampleLod(dt);
+		float val = sampleWindowed(p, lod);
+#if defined(RENDER_MIP)
+		max_val = max(max_val, val);
+		if (max_val >= 1.0)
+			break;
+#elif defined(RENDER_MINIP)
+		min_val = min(min_val, val);
+		if (min_val <= 0.0)
+			break;
+#elif defined(RENDER_AVERAGE)
+		// Each sample stands for the step after it; skipped space adds zero.
+		sum_val += val * min(dt, t_hit.y - t);
+#elif defined(RENDER_ISOSURFACE)
+		if (val >= u_IsoValue) {
+			// The crossing lies between the last sample below the isovalue and
+			// this one; halve that interval instead of taking tiny steps.
+			float t_lo = prev_t;
+			float t_hi = t;
+			for (int i = 0; i < u_RefineSteps; i++) {
+				float t_mid = 0.5 * (t_lo + t_hi);
+				if (sampleWindowed(ray_origin + ray_dir * t_mid, lod) >= u_IsoValue)
+					t_hi = t_mid;
+				else
+					t_lo = t_mid;
+			}
+			// Phong when lighting is on, else a two-sided headlight.
+			vec3 hit = ray_origin + ray_dir * t_hi;
+			vec3 base = textureLod(colormap, vec2(u_IsoValue, 0.5), 0.0).rgb;
+			if (u_Shading != 0) {
+				u_Color = vec4(base * phong(hit, ray_dir, lod), 1.0);
+				return;
+			}
+			vec3 grad = gradientAt(hit, lod);
+			float diffuse = length(grad) > 0.0 ? abs(dot(normalize(grad), ray_dir)) : 1.0;
+			u_Color = vec4(base * (0.25 + 0.75 * diffuse), 1.0);
+			return;
+		}
+#else
+		vec4 val_color = vec4(textureLod(colormap, vec2(val, 0.5), 0.0).rgb, val >= u_OpacityCutoff ? val : 0.0);
+
+		// Step 4.2: Accumulate the color and opacity
+#if defined(COMPOSITE_PREINTEGRATED)
+		{
+			// The segment from the previous sample; the first sample of a ray
+			// stands for a constant segment.
+			float front = prev_val < 0.0 ? val : prev_val;
+			vec2 uv = (vec2(front, val) * (u_PreIntegrationSize - 1.0) + 0.5) / u_PreIntegrationSize;
+			vec4 segment = textureLod(u_PreIntegration, uv, 0.0);
+			segment.rgb *= shadeSample(p, ray_dir, lod, segment.a);
+			float alpha = 1.0 - pow(1.0 - min(segment.a, 0.9999), seg_dt / dt_voxel);
+			u_Color.rgb += (1.0 - u_Color.a) * segment.rgb * (segment.a > 0.0 ? alpha / segment.a : 1.0);
+			u_Color.a += (1.0 - u_Color.a) * alpha;
+		}
+#elif defined(COMPOSITE_LEGACY)
+		u_Color.rgb += val_color.rgb * shadeSample(p, ray_dir, lod, val_color.a);
+		u_Color.a += val_color.a;
+#else
+		{
+			// Front-to-back with the opacity corrected for the step length.
+			float alpha = 1.0 - pow(1.0 - val_color.a, dt / dt_voxel);
+			u_Color.rgb += (1.0 - u_Color.a) * alpha * val_color.rgb * shadeSample(p, ray_dir, lod, val_color.a);
+			u_Color.a += (1.0 - u_Color.a) * alpha;
+		}
+#endif
+
 		// Optimization: break out of the loop when the color is near opaque
 		if (u_Color.a >= 0.95 ){
 			break;
 		}
-		p += ray_dir * dt ;
-	}
+#endif
+		prev_t = t;
+		t += dt;
+		seg_dt = dt;
 
+#if defined(RENDER_COMPOSITE)
+		// Adaptive step for the next sample: up to u_MaxStepScale voxels
+		// through transparent regions, shrinking towards u_MinStepScale where
+		// the value changes quickly between samples.
+		if (u_AdaptiveStep) {
+			float gradient = prev_val < 0.0 ? 0.0 : abs(val - prev_val) * dt_voxel / dt;
+			float scale = mix(u_MaxStepScale, u_StepScale, clamp(val_color.a * 8.0, 0.0, 1.0));
+			scale /= 1.0 + u_GradientSensitivity * gradient;
+			dt = clamp(scale, u_MinStepScale, u_MaxStepScale) * dt_voxel;
+		}
+#endif
+		prev_val = val;
+	}
 
+	// Step 5: Projections map their value through the colormap.
+#if defined(RENDER_MIP)
+	u_Color = vec4(textureLod(colormap, vec2(max_val, 0.5), 0.0).rgb, 1.0);
+#elif defined(RENDER_MINIP)
+	u_Color = vec4(textureLod(colormap, vec2(min_val, 0.5), 0.0).rgb, 1.0);
+#elif defined(RENDER_AVERAGE)
+	float avg_val = t_hit.y > t_hit.x ? sum_val / (t_hit.y - t_hit.x) : 0.0;
+	u_Color = vec4(textureLod(colormap, vec2(avg_val, 0.5), 0.0).rgb, 1.0);
+#elif defined(RENDER_ISOSURFACE)
+	discard;
+#endif
 }
@@ -0,0 +1,22 @@
+#shader vertex
+#version 330 core
+layout(location = 0) in vec4 position;
+uniform mat4 model;
+out vec3 FragPos;
+void main()
+{
+	gl_Position = model * position;
+	FragPos = vec3(position);
+}
+
+
+#shader fragment
+#version 330 core
+in vec3 FragPos;
+layout(location = 0) out vec4 u_Color;
+// Drawn over the volume's bounding box while the raymarch programs are
+// still compiling.
+void main()
+{
+	u_Color = vec4(0.2 + 0.3 * clamp(FragPos, 0.0, 1.0), 0.5);
+}
@@ -0,0 +1,20 @@
+#shader vertex
+#version 330 core
+layout(location = 0) in vec4 position;
+out vec2 texCoord;
+void main()
+{
+	gl_Position = position;
+	texCoord = position.xy * 0.5 + 0.5;
+}
+
+
+#shader fragment
+#version 330 core
+in vec2 texCoord;
+layout(location = 0) out vec4 u_Color;
+uniform sampler2D u_Image;
+void main()
+{
+	u_Color = textureLod(u_Image, texCoord, 0.0);
+}
@@ -0,0 +1,23 @@
+#shader vertex
+#version 330 core
+layout(location = 0) in vec4 position;
+uniform mat4 model;
+// Object-space box the volume fills.
+uniform vec3 u_BoxMin;
+uniform vec3 u_BoxSize;
+out vec3 volumePos;
+void main()
+{
+	gl_Position = model * position;
+	volumePos = (position.xyz - u_BoxMin) / u_BoxSize;
+}
+
+
+#shader fragment
+#version 330 core
+in vec3 volumePos;
+layout(location = 0) out vec4 u_Color;
+void main()
+{
+	u_Color = vec4(clamp(volumePos, 0.0, 1.0), 1.0);
+}
@@ -0,0 +1,99 @@
+#include "renderer.hpp"
+#include "shadercompiler.hpp"
+
+ShaderCompiler::ShaderCompiler(GLContext & context)
+{
+	if (GLEW_KHR_parallel_shader_compile) {
+		// Let the driver pick the number of compiler threads.
+		GLCall(glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu));
+		m_Parallel = true;
+		return;
+	}
+	m_WorkerContext = context.createShared();
+	if (m_WorkerContext)
+		m_Worker = std::thread(&ShaderCompiler::WorkerLoop, this);
+}
+
+ShaderCompiler::~ShaderCompiler()
+{
+	if (m_Worker.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Quit = true;
+		}
+		m_Wake.notify_one();
+		m_Worker.join();
+	}
+	m_Programs.clear();
+	m_WorkerContext.reset();
+}
+
+int ShaderCompiler::Submit(const std::string& filepath, const std::vector<std::string>& defines)
+{
+	int handle = (int)m_Programs.size();
+	if (m_Worker.joinable()) {
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Programs.emplace_back();
+		m_Ready.push_back(false);
+		m_Queue.push_back({ handle, { filepath, defines } });
+		m_Wake.notify_one();
+		return handle;
+	}
+	m_Programs.emplace_back(new ShaderProgram(filepath, defines, !m_Parallel));
+	m_Ready.push_back(!m_Parallel);
+	return handle;
+}
+
+ShaderProgram* ShaderCompiler::Get(int handle)
+{
+	if (m_Worker.joinable()) {
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		return m_Ready[handle] ? m_Programs[handle].get() : nullptr;
+	}
+	if (!m_Ready[handle]) {
+		if (!m_Programs[handle]->IsReady())
+			return nullptr;
+		m_Programs[handle]->Finish();
+		m_Ready[handle] = true;
+	}
+	return m_Programs[handle].get();
+}
+
+bool ShaderCompiler::Done()
+{
+	bool done = true;
+	for (int handle = 0; handle < (int)m_Programs.size(); handle++)
+		done = Get(handle) != nullptr && done;
+	return done;
+}
+
+const char* ShaderCompiler::Mode() const
+{
+	if (m_Parallel)
+		return "parallel driver compile";
+	return m_Worker.joinable() ? "worker thread" : "synchronous";
+}
+
+void ShaderCompiler::WorkerLoop()
+{
+	m_WorkerContext->makeCurrent();
+	for (;;)
+	{
+		std::pair<int, Job> job;
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_Wake.wait(lock, [this] { return m_Quit || !m_Queue.empty(); });
+			if (m_Quit)
+				break;
+			job = std::move(m_Queue.front());
+			m_Queue.erase(m_Queue.begin());
+		}
+		std::unique_ptr<ShaderProgram> program(new ShaderProgram(job.second.filepath, job.second.defines));
+		// The program has to be complete before the render context uses it.
+		GLCall(glFinish());
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Programs[job.first] = std::move(program);
+		m_Ready[job.first] = true;
+	}
+	m_WorkerContext->releaseCurrent();
+}
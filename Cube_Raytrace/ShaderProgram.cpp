@@ -0,0 +1,208 @@
+#include <chrono>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+
+#include "programcache.hpp"
+#include "renderer.hpp"
+#include "shaderprogram.hpp"
+
+ShaderProgramSource ParseShader(const std::string& filepath)
+{
+	std::ifstream stream(filepath);
+	std::string line;
+	std::stringstream ss[2];
+	int Shadertype = -1;
+
+	while (getline(stream, line))
+	{
+		if (line.find("#shader") != std::string::npos)
+		{
+			if (line.find("vertex") != std::string::npos)
+				Shadertype = 0;
+			else if (line.find("fragment") != std::string::npos)
+				Shadertype = 1;
+		}
+		else if (Shadertype >= 0)
+		{
+			ss[Shadertype] << line << '\n';
+		}
+	}
+	return { ss[0].str(), ss[1].str() };
+}
+
+std::string InjectDefines(const std::string& source, const std::vector<std::string>& defines)
+{
+	if (defines.empty())
+		return source;
+	std::string block;
+	for (const std::string& define : defines)
+		block += "#define " + define + "\n";
+	size_t version = source.find("#version");
+	if (version == std::string::npos)
+		return block + source;
+	size_t lineEnd = source.find('\n', version);
+	if (lineEnd == std::string::npos)
+		return source + "\n" + block;
+	return source.substr(0, lineEnd + 1) + block + source.substr(lineEnd + 1);
+}
+
+// Only queues the compile: querying the status right away would make the
+// driver finish it on this thread.
+static unsigned int CompileShader(unsigned int type, const std::string& source)
+{
+	GLCall(unsigned int id = glCreateShader(type));
+	const char* src = source.c_str();
+	GLCall(glShaderSource(id, 1, &src, nullptr));
+	GLCall(glCompileShader(id));
+	return id;
+}
+
+static void ReportShader(unsigned int id, unsigned int type)
+{
+	int result;
+	GLCall(glGetShaderiv(id, GL_COMPILE_STATUS, &result));
+	if (result == GL_FALSE)
+	{
+		int length;
+		GLCall(glGetShaderiv(id, GL_INFO_LOG_LENGTH, &length));
+		std::vector<char> message(length + 1);
+		GLCall(glGetShaderInfoLog(id, length, &length, message.data()));
+		std::cout
+			<< "Failed to compile "
+			<< (type == GL_VERTEX_SHADER ? "vertex" : "fragment")
+			<< "shader"
+			<< std::endl;
+		std::cout << message.data() << std::endl;
+	}
+}
+
+ShaderProgram::ShaderProgram(const std::string& filepath, const std::vector<std::string>& defines, bool wait)
+	: m_FilePath(filepath), m_Defines(defines), m_Start(std::chrono::steady_clock::now())
+{
+	ShaderProgramSource source = ParseShader(filepath);
+	std::string vertexSource = InjectDefines(source.VertexSource, defines);
+	std::string fragmentSource = InjectDefines(source.FragmentSource, defines);
+	GLCall(m_RendererID = glCreateProgram());
+
+	m_Cached = programCacheAvailable();
+	if (m_Cached) {
+		m_CacheKey = programCacheKey({ vertexSource, fragmentSource });
+		m_CachePath = programCachePath(filepath, defines);
+		if (loadProgramBinary(m_CachePath, m_CacheKey, m_RendererID)) {
+			m_Linked = true;
+			m_FromCache = true;
+			m_BuildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_Start).count();
+			return;
+		}
+		GLCall(glProgramParameteri(m_RendererID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
+	}
+
+	m_VertexShader = CompileShader(GL_VERTEX_SHADER, vertexSource);
+	m_FragmentShader = CompileShader(GL_FRAGMENT_SHADER, fragmentSource);
+	GLCall(glAttachShader(m_RendererID, m_VertexShader));
+	GLCall(glAttachShader(m_RendererID, m_FragmentShader));
+	GLCall(glLinkProgram(m_RendererID));
+	m_Pending = true;
+	if (wait)
+		Finish();
+}
+
+bool ShaderProgram::IsReady() const
+{
+	if (!m_Pending || !GLEW_KHR_parallel_shader_compile)
+		return true;
+	GLint done = GL_FALSE;
+	GLCall(glGetProgramiv(m_RendererID, GL_COMPLETION_STATUS_KHR, &done));
+	return done == GL_TRUE;
+}
+
+void ShaderProgram::Finish()
+{
+	if (!m_Pending)
+		return;
+	m_Pending = false;
+	GLint program_linked;
+	GLCall(glGetProgramiv(m_RendererID, GL_LINK_STATUS, &program_linked));
+	if (program_linked != GL_TRUE)
+	{
+		ReportShader(m_VertexShader, GL_VERTEX_SHADER);
+		ReportShader(m_FragmentShader, GL_FRAGMENT_SHADER);
+		GLsizei log_length = 0;
+		GLchar message[1024];
+		GLCall(glGetProgramInfoLog(m_RendererID, 1024, &log_length, message));
+		std::cout << "Failed to link program " << m_FilePath;
+		for (const std::string& define : m_Defines)
+			std::cout << " " << define;
+		std::cout << std::endl << message << std::endl;
+	}
+
+	GLCall(glDetachShader(m_RendererID, m_VertexShader));
+	GLCall(glDetachShader(m_RendererID, m_FragmentShader));
+	GLCall(glDeleteShader(m_VertexShader));
+	GLCall(glDeleteShader(m_FragmentShader));
+	m_VertexShader = m_FragmentShader = 0;
+	m_Linked = program_linked == GL_TRUE;
+	if (m_Cached && m_Linked)
+		saveProgramBinary(m_CachePath, m_CacheKey, m_RendererID);
+	m_BuildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_Start).count();
+}
+
+ShaderProgram::~ShaderProgram()
+{
+	Finish();
+	GLCall(glDeleteProgram(m_RendererID));
+}
+
+void ShaderProgram::Bind() const
+{
+	GLCall(glUseProgram(m_RendererID));
+}
+
+void ShaderProgram::Unbind() const
+{
+	GLCall(glUseProgram(0));
+}
+
+void ShaderProgram::SetUniform1i(const std::string& name, int value)
+{
+	GLCall(glUniform1i(GetUniformLocation(name), value));
+}
+
+void ShaderProgram::SetUniform1f(const std::string& name, float value)
+{
+	GLCall(glUniform1f(GetUniformLocation(name), value));
+}
+
+void ShaderProgram::SetUniform3f(const std::string& name, float v0, float v1, float v2)
+{
+	GLCall(glUniform3f(GetUniformLocation(name), v0, v1, v2));
+}
+
+void ShaderProgram::SetUniformMat4f(const std::string& name, const float * matrix)
+{
+	GLCall(glUniformMatrix4fv(GetUniformLocation(name), 1, GL_FALSE, matrix));
+}
+
+void ShaderProgram::SetUniformBlockBinding(const std::string& name, unsigned int binding)
+{
+	auto it = m_UniformBlockBindings.find(name);
+	if (it != m_UniformBlockBindings.end() && it->second == binding)
+		return;
+	m_UniformBlockBindings[name] = binding;
+	GLCall(unsigned int index = glGetUniformBlockIndex(m_RendererID, name.c_str()));
+	if (index != GL_INVALID_INDEX) {
+		GLCall(glUniformBlockBinding(m_RendererID, index, binding));
+	}
+}
+
+int ShaderProgram::GetUniformLocation(const std::string& name)
+{
+	auto it = m_UniformLocationCache.find(name);
+	if (it != m_UniformLocationCache.end())
+		return it->second;
+	// -1 is cached too: uniforms a permutation compiles out are set silently.
+	GLCall(int location = glGetUniformLocation(m_RendererID, name.c_str()));
+	m_UniformLocationCache[name] = location;
+	return location;
+}
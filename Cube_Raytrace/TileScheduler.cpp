@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#include "morton.hpp"
+#include "parallel.hpp"
+#include "tilescheduler.hpp"
+
+double TileStats::utilization(int w) const
+{
+	if (wallMs <= 0.0 || workers.empty())
+		return 0.0;
+	if (w >= 0)
+		return w < (int)workers.size() ? workers[w].busyMs / wallMs : 0.0;
+	double busy = 0.0;
+	for (const TileWorkerStats& worker : workers)
+		busy += worker.busyMs;
+	return busy / (wallMs * workers.size());
+}
+
+namespace {
+
+// The run [begin, end) of the Morton-ordered tile list a worker still owns.
+// Padded to a cache line so neighbouring queues do not share one.
+struct alignas(64) TileQueue
+{
+	std::mutex lock;
+	size_t begin = 0;
+	size_t end = 0;
+};
+
+}
+
+void forEachTile(
+	int width,
+	int height,
+	int tileSize,
+	const std::function<void(const Tile &, unsigned int)> & fn,
+	TileStats * out_stats,
+	unsigned int workers)
+{
+	auto start = std::chrono::steady_clock::now();
+	if (tileSize <= 0)
+		tileSize = 16;
+	int tilesX = width > 0 ? (width + tileSize - 1) / tileSize : 0;
+	int tilesY = height > 0 ? (height + tileSize - 1) / tileSize : 0;
+	std::vector<uint32_t> order;
+	order.reserve((size_t)tilesX * tilesY);
+	for (int ty = 0; ty < tilesY; ty++)
+		for (int tx = 0; tx < tilesX; tx++)
+			order.push_back(mortonEncode2(tx, ty));
+	std::sort(order.begin(), order.end());
+
+	if (workers == 0)
+		workers = workerCount();
+	workers = std::max(1u, std::min<unsigned int>(workers, (unsigned int)std::max<size_t>(order.size(), 1)));
+	std::vector<TileQueue> queues(workers);
+	for (unsigned int w = 0; w < workers; w++) {
+		queues[w].begin = order.size() * w / workers;
+		queues[w].end = order.size() * (w + 1) / workers;
+	}
+	std::vector<TileWorkerStats> stats(workers);
+
+	auto run = [&](unsigned int self) {
+		TileQueue& own = queues[self];
+		// Kept on this thread's stack until the end, not next to the others.
+		TileWorkerStats mine;
+		uint32_t random = 2654435761u * (self + 1);
+		for (;;) {
+			size_t index;
+			{
+				std::lock_guard<std::mutex> guard(own.lock);
+				index = own.begin < own.end ? own.begin++ : order.size();
+			}
+			if (index == order.size()) {
+				// Steal the back half of the first non-empty run, visiting the
+				// others from a random offset so thieves spread out.
+				size_t stolenBegin = 0, stolenEnd = 0;
+				random ^= random << 13;
+				random ^= random >> 17;
+				random ^= random << 5;
+				for (unsigned int i = 0; i < workers - 1 && stolenEnd == 0; i++) {
+					TileQueue& victim = queues[(self + 1 + (random + i) % (workers - 1)) % workers];
+					std::lock_guard<std::mutex> guard(victim.lock);
+					size_t remaining = victim.end - victim.begin;
+					if (remaining == 0) {
+						mine.failedSteals++;
+						continue;
+					}
+					stolenEnd = victim.end;
+					victim.end -= (remaining + 1) / 2;
+					stolenBegin = victim.end;
+				}
+				// No new tiles appear once started, so all runs being empty
+				// means the image is done or being finished by others.
+				if (stolenEnd == 0)
+					break;
+				mine.stolen += stolenEnd - stolenBegin;
+				std::lock_guard<std::mutex> guard(own.lock);
+				own.begin = stolenBegin;
+				own.end = stolenEnd;
+				continue;
+			}
+
+			uint32_t tx, ty;
+			mortonDecode2(order[index], tx, ty);
+			Tile tile;
+			tile.x0 = tx * tileSize;
+			tile.y0 = ty * tileSize;
+			tile.x1 = std::min(tile.x0 + tileSize, width);
+			tile.y1 = std::min(tile.y0 + tileSize, height);
+			auto tileStart = std::chrono::steady_clock::now();
+			fn(tile, self);
+			mine.busyMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tileStart).count();
+			mine.tiles++;
+		}
+		stats[self] = mine;
+	};
+
+	std::vector<std::thread> threads;
+	threads.reserve(workers - 1);
+	for (unsigned int w = 1; w < workers; w++)
+		threads.emplace_back(run, w);
+	run(0);
+	for (auto& t : threads)
+		t.join();
+
+	if (out_stats) {
+		out_stats->workers = stats;
+		out_stats->wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+}
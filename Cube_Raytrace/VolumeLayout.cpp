@@ -0,0 +1,64 @@
+#include <algorithm>
+#include <cstring>
+
+#include "volumelayout.hpp"
+
+bool parseVoxelLayout(const char * name, VoxelLayout & out_layout)
+{
+	if (strcmp(name, "linear") == 0)
+		out_layout = VoxelLayout::Linear;
+	else if (strcmp(name, "blocked") == 0)
+		out_layout = VoxelLayout::Blocked;
+	else if (strcmp(name, "morton") == 0)
+		out_layout = VoxelLayout::Morton;
+	else
+		return false;
+	return true;
+}
+
+const char* voxelLayoutName(VoxelLayout layout)
+{
+	switch (layout)
+	{
+	case VoxelLayout::Linear: return "linear";
+	case VoxelLayout::Blocked: return "blocked";
+	case VoxelLayout::Morton: return "morton";
+	}
+	return "unknown";
+}
+
+VoxelGrid makeVoxelGrid(VoxelLayout layout, uint32_t dx, uint32_t dy, uint32_t dz)
+{
+	VoxelGrid grid;
+	grid.layout = layout;
+	grid.dims[0] = dx;
+	grid.dims[1] = dy;
+	grid.dims[2] = dz;
+	if (dx == 0 || dy == 0 || dz == 0)
+		return grid;
+	switch (layout)
+	{
+	case VoxelLayout::Linear:
+		grid.stride[0] = 1;
+		grid.stride[1] = dx;
+		grid.stride[2] = (size_t)dx * dy;
+		grid.size = (size_t)dx * dy * dz;
+		break;
+	case VoxelLayout::Blocked: {
+		size_t bx = (dx + 3) / 4;
+		size_t by = (dy + 3) / 4;
+		size_t bz = (dz + 3) / 4;
+		grid.stride[0] = 64;
+		grid.stride[1] = 64 * bx;
+		grid.stride[2] = 64 * bx * by;
+		grid.size = 64 * bx * by * bz;
+		break;
+	}
+	case VoxelLayout::Morton:
+		// Codes only grow with each coordinate, so the far corner has the
+		// highest address.
+		grid.size = voxelAddress<VoxelLayout::Morton>(grid, dx - 1, dy - 1, dz - 1) + 1;
+		break;
+	}
+	return grid;
+}
@@ -0,0 +1,266 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+#include "parallel.hpp"
+#include "volumemip.hpp"
+
+// Mip pyramid ingest.
+// Each level is computed from the previous one, so the source (usually the
+// file mapping) is streamed exactly once; every level after that reads an
+// eighth of the data the one before it did.
+
+struct MipFileHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t voxelType;
+	uint32_t filter;
+	uint32_t dims[3];
+	uint32_t levels;
+	uint64_t sourceSize;
+	int64_t sourceTime;
+};
+
+static const uint32_t kMipVersion = 1;
+
+bool parseMipFilter(const char * name, MipFilter & out_filter)
+{
+	if (strcmp(name, "none") == 0)
+		out_filter = MipFilter::None;
+	else if (strcmp(name, "average") == 0 || strcmp(name, "mip") == 0)
+		out_filter = MipFilter::Average;
+	else if (strcmp(name, "max") == 0)
+		out_filter = MipFilter::Max;
+	else
+		return false;
+	return true;
+}
+
+const char* mipFilterName(MipFilter filter)
+{
+	switch (filter) {
+	case MipFilter::None: return "none";
+	case MipFilter::Average: return "average";
+	case MipFilter::Max: return "max";
+	}
+	return "unknown";
+}
+
+int mipLevelCount(int dx, int dy, int dz)
+{
+	int levels = 1;
+	for (int size = std::max(dx, std::max(dy, dz)); size > 1; size /= 2)
+		levels++;
+	return levels;
+}
+
+template <typename T>
+static T averageOf(double sum, int n, std::true_type)
+{
+	return (T)std::llround(sum / n);
+}
+
+template <typename T>
+static T averageOf(double sum, int n, std::false_type)
+{
+	return (T)(sum / n);
+}
+
+// Source index range [begin[i], end[i]) covered by output texel i.
+static void footprints(int srcSize, int dstSize, std::vector<int> & begin, std::vector<int> & end)
+{
+	begin.resize(dstSize);
+	end.resize(dstSize);
+	for (int i = 0; i < dstSize; i++)
+	{
+		begin[i] = (int)((int64_t)i * srcSize / dstSize);
+		end[i] = std::max(begin[i] + 1, (int)((int64_t)(i + 1) * srcSize / dstSize));
+	}
+}
+
+template <typename T>
+static void downsample(const T * src, const int srcDims[3], T * dst, const int dstDims[3], MipFilter filter)
+{
+	std::vector<int> begin[3], end[3];
+	for (int a = 0; a < 3; a++)
+		footprints(srcDims[a], dstDims[a], begin[a], end[a]);
+	size_t srcRow = srcDims[0];
+	size_t srcSlice = srcRow * srcDims[1];
+
+	parallelFor(0, dstDims[2], 1, [&](size_t zb, size_t ze, size_t) {
+		for (size_t z = zb; z < ze; z++)
+			for (int y = 0; y < dstDims[1]; y++)
+			{
+				T* out = dst + (z * dstDims[1] + y) * dstDims[0];
+				for (int x = 0; x < dstDims[0]; x++)
+				{
+					double sum = 0.0;
+					T maxValue = src[begin[2][z] * srcSlice + begin[1][y] * srcRow + begin[0][x]];
+					int n = 0;
+					for (int sz = begin[2][z]; sz < end[2][z]; sz++)
+						for (int sy = begin[1][y]; sy < end[1][y]; sy++)
+						{
+							const T* row = src + sz * srcSlice + sy * srcRow;
+							for (int sx = begin[0][x]; sx < end[0][x]; sx++)
+							{
+								sum += row[sx];
+								maxValue = std::max(maxValue, row[sx]);
+							}
+							n += end[0][x] - begin[0][x];
+						}
+					out[x] = filter == MipFilter::Max ? maxValue
+						: averageOf<T>(sum, n, std::is_integral<T>());
+				}
+			}
+	});
+}
+
+template <typename T>
+void buildVolumeMip(const T * voxels, int dx, int dy, int dz, MipFilter filter, VolumeMip<T> & out)
+{
+	out.filter = filter;
+	out.levels.clear();
+	out.dims.assign({ dx, dy, dz });
+	if (filter == MipFilter::None)
+		return;
+
+	int levels = mipLevelCount(dx, dy, dz);
+	const T* src = voxels;
+	for (int level = 1; level < levels; level++)
+	{
+		const int* srcDims = out.levelDims(level - 1);
+		int dims[3];
+		for (int a = 0; a < 3; a++)
+			dims[a] = std::max(1, srcDims[a] / 2);
+		out.levels.emplace_back((size_t)dims[0] * dims[1] * dims[2]);
+		downsample(src, srcDims, out.levels.back().data(), dims, filter);
+		out.dims.insert(out.dims.end(), dims, dims + 3);
+		src = out.levels.back().data();
+	}
+}
+
+static bool sourceStamp(const char * path, uint64_t & size, int64_t & time)
+{
+#ifdef _WIN32
+	struct _stat64 info;
+	if (_stat64(path, &info) != 0)
+		return false;
+#else
+	struct stat info;
+	if (stat(path, &info) != 0)
+		return false;
+#endif
+	size = (uint64_t)info.st_size;
+	time = (int64_t)info.st_mtime;
+	return true;
+}
+
+static std::string mipPath(const char * path)
+{
+	return std::string(path) + ".mip";
+}
+
+template <typename T>
+bool loadVolumeMip(const char * path, int dx, int dy, int dz, MipFilter filter, VolumeMip<T> & out)
+{
+	uint64_t size;
+	int64_t time;
+	if (!sourceStamp(path, size, time))
+		return false;
+	FILE* file = fopen(mipPath(path).c_str(), "rb");
+	if (file == NULL)
+		return false;
+
+	MipFileHeader header;
+	bool valid = fread(&header, sizeof(header), 1, file) == 1
+		&& memcmp(header.magic, "VMIP", 4) == 0
+		&& header.version == kMipVersion
+		&& header.voxelType == (uint32_t)VoxelTraits<T>::type
+		&& header.filter == (uint32_t)filter
+		&& header.dims[0] == (uint32_t)dx && header.dims[1] == (uint32_t)dy && header.dims[2] == (uint32_t)dz
+		&& header.levels == (uint32_t)mipLevelCount(dx, dy, dz)
+		&& header.sourceSize == size && header.sourceTime == time;
+	if (valid) {
+		out.filter = filter;
+		out.levels.clear();
+		out.dims.assign({ dx, dy, dz });
+		for (uint32_t level = 1; valid && level < header.levels; level++)
+		{
+			const int* srcDims = out.levelDims(level - 1);
+			int dims[3];
+			for (int a = 0; a < 3; a++)
+				dims[a] = std::max(1, srcDims[a] / 2);
+			size_t count = (size_t)dims[0] * dims[1] * dims[2];
+			out.levels.emplace_back(count);
+			valid = fread(out.levels.back().data(), sizeof(T), count, file) == count;
+			out.dims.insert(out.dims.end(), dims, dims + 3);
+		}
+	}
+	fclose(file);
+	if (!valid)
+		out = VolumeMip<T>();
+	return valid;
+}
+
+template <typename T>
+bool saveVolumeMip(const char * path, const VolumeMip<T> & mip)
+{
+	MipFileHeader header = {};
+	memcpy(header.magic, "VMIP", 4);
+	header.version = kMipVersion;
+	header.voxelType = (uint32_t)VoxelTraits<T>::type;
+	header.filter = (uint32_t)mip.filter;
+	for (int a = 0; a < 3; a++)
+		header.dims[a] = (uint32_t)mip.dims[a];
+	header.levels = (uint32_t)mip.levelCount();
+	if (!sourceStamp(path, header.sourceSize, header.sourceTime))
+		return false;
+
+	std::string out = mipPath(path);
+	FILE* file = fopen(out.c_str(), "wb");
+	if (file == NULL) {
+		printf("Impossible to write %s\n", out.c_str());
+		return false;
+	}
+	bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+	for (size_t level = 0; written && level < mip.levels.size(); level++)
+		written = fwrite(mip.levels[level].data(), sizeof(T), mip.levels[level].size(), file) == mip.levels[level].size();
+	fclose(file);
+	if (!written) {
+		printf("Impossible to write %s\n", out.c_str());
+		remove(out.c_str());
+	}
+	return written;
+}
+
+template <typename T>
+void ingestVolumeMip(const char * path, const T * voxels, int dx, int dy, int dz, MipFilter filter, VolumeMip<T> & out)
+{
+	if (filter == MipFilter::None) {
+		buildVolumeMip(voxels, dx, dy, dz, filter, out);
+		return;
+	}
+	if (loadVolumeMip(path, dx, dy, dz, filter, out)) {
+		printf("Loaded %d %s mip levels from %s.mip\n", out.levelCount(), mipFilterName(filter), path);
+		return;
+	}
+	buildVolumeMip(voxels, dx, dy, dz, filter, out);
+	if (saveVolumeMip(path, out))
+		printf("Built %d %s mip levels into %s.mip\n", out.levelCount(), mipFilterName(filter), path);
+}
+
+#define INSTANTIATE_VOLUMEMIP(T) \
+	template void buildVolumeMip<T>(const T *, int, int, int, MipFilter, VolumeMip<T> &); \
+	template bool loadVolumeMip<T>(const char *, int, int, int, MipFilter, VolumeMip<T> &); \
+	template bool saveVolumeMip<T>(const char *, const VolumeMip<T> &); \
+	template void ingestVolumeMip<T>(const char *, const T *, int, int, int, MipFilter, VolumeMip<T> &);
+INSTANTIATE_VOLUMEMIP(unsigned char)
+INSTANTIATE_VOLUMEMIP(unsigned short)
+INSTANTIATE_VOLUMEMIP(int)
+INSTANTIATE_VOLUMEMIP(float)
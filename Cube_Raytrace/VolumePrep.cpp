@@ -0,0 +1,242 @@
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define VOLUMEPREP_AVX2
+#elif defined(__SSE4_1__) || defined(__AVX__)
+#include <smmintrin.h>
+#define VOLUMEPREP_SSE41
+#endif
+
+#include "parallel.hpp"
+#include "volumeprep.hpp"
+
+// Volume ingest kernels.
+// Each pass is memory bound once vectorized, so the volume is cut into one
+// contiguous chunk per core; min/max partials are merged at the end.
+// SimdOps<T> supplies the per-type loads, compares and widening conversion
+// so every voxel type compiles to its own straight-line kernel.
+
+static const size_t kVoxelGrain = 1 << 16;
+
+#if defined(VOLUMEPREP_AVX2)
+typedef __m256i IntVec;
+typedef __m256 FloatVec;
+static const size_t kFloatLanes = 8;
+
+static inline IntVec loadInt(const void * p) { return _mm256_loadu_si256((const __m256i*)p); }
+static inline void storeInt(void * p, IntVec v) { _mm256_storeu_si256((__m256i*)p, v); }
+
+template <typename T> struct SimdOps;
+template <> struct SimdOps<unsigned char>
+{
+	typedef IntVec Vec;
+	static Vec load(const unsigned char * p) { return loadInt(p); }
+	static Vec min(Vec a, Vec b) { return _mm256_min_epu8(a, b); }
+	static Vec max(Vec a, Vec b) { return _mm256_max_epu8(a, b); }
+	static void store(unsigned char * p, Vec v) { storeInt(p, v); }
+	static FloatVec toFloat(const unsigned char * p) { return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)p))); }
+};
+template <> struct SimdOps<unsigned short>
+{
+	typedef IntVec Vec;
+	static Vec load(const unsigned short * p) { return loadInt(p); }
+	static Vec min(Vec a, Vec b) { return _mm256_min_epu16(a, b); }
+	static Vec max(Vec a, Vec b) { return _mm256_max_epu16(a, b); }
+	static void store(unsigned short * p, Vec v) { storeInt(p, v); }
+	static FloatVec toFloat(const unsigned short * p) { return _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)p))); }
+};
+template <> struct SimdOps<int>
+{
+	typedef IntVec Vec;
+	static Vec load(const int * p) { return loadInt(p); }
+	static Vec min(Vec a, Vec b) { return _mm256_min_epi32(a, b); }
+	static Vec max(Vec a, Vec b) { return _mm256_max_epi32(a, b); }
+	static void store(int * p, Vec v) { storeInt(p, v); }
+	static FloatVec toFloat(const int * p) { return _mm256_cvtepi32_ps(loadInt(p)); }
+};
+template <> struct SimdOps<float>
+{
+	typedef FloatVec Vec;
+	static Vec load(const float * p) { return _mm256_loadu_ps(p); }
+	static Vec min(Vec a, Vec b) { return _mm256_min_ps(a, b); }
+	static Vec max(Vec a, Vec b) { return _mm256_max_ps(a, b); }
+	static void store(float * p, Vec v) { _mm256_storeu_ps(p, v); }
+	static FloatVec toFloat(const float * p) { return _mm256_loadu_ps(p); }
+};
+
+static inline FloatVec splat(float x) { return _mm256_set1_ps(x); }
+static inline FloatVec subf(FloatVec a, FloatVec b) { return _mm256_sub_ps(a, b); }
+static inline FloatVec mulf(FloatVec a, FloatVec b) { return _mm256_mul_ps(a, b); }
+static inline FloatVec divf(FloatVec a, FloatVec b) { return _mm256_div_ps(a, b); }
+static inline IntVec truncate(FloatVec f) { return _mm256_cvttps_epi32(f); }
+
+// Packs four vectors of 8 int32 in [0, 255] into 32 ordered bytes.
+static inline void storeBytes(unsigned char * out, const IntVec q[4])
+{
+	const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	__m256i ab = _mm256_packus_epi32(q[0], q[1]);
+	__m256i cd = _mm256_packus_epi32(q[2], q[3]);
+	storeInt(out, _mm256_permutevar8x32_epi32(_mm256_packus_epi16(ab, cd), order));
+}
+#elif defined(VOLUMEPREP_SSE41)
+typedef __m128i IntVec;
+typedef __m128 FloatVec;
+static const size_t kFloatLanes = 4;
+
+static inline IntVec loadInt(const void * p) { return _mm_loadu_si128((const __m128i*)p); }
+static inline void storeInt(void * p, IntVec v) { _mm_storeu_si128((__m128i*)p, v); }
+
+template <typename T> struct SimdOps;
+template <> struct SimdOps<unsigned char>
+{
+	typedef IntVec Vec;
+	static Vec load(const unsigned char * p) { return loadInt(p); }
+	static Vec min(Vec a, Vec b) { return _mm_min_epu8(a, b); }
+	static Vec max(Vec a, Vec b) { return _mm_max_epu8(a, b); }
+	static void store(unsigned char * p, Vec v) { storeInt(p, v); }
+	static FloatVec toFloat(const unsigned char * p)
+	{
+		int packed;
+		memcpy(&packed, p, sizeof(packed));
+		return _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(packed)));
+	}
+};
+template <> struct SimdOps<unsigned short>
+{
+	typedef IntVec Vec;
+	static Vec load(const unsigned short * p) { return loadInt(p); }
+	static Vec min(Vec a, Vec b) { return _mm_min_epu16(a, b); }
+	static Vec max(Vec a, Vec b) { return _mm_max_epu16(a, b); }
+	static void store(unsigned short * p, Vec v) { storeInt(p, v); }
+	static FloatVec toFloat(const unsigned short * p) { return _mm_cvtepi32_ps(_mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i*)p))); }
+};
+template <> struct SimdOps<int>
+{
+	typedef IntVec Vec;
+	static Vec load(const int * p) { return loadInt(p); }
+	static Vec min(Vec a, Vec b) { return _mm_min_epi32(a, b); }
+	static Vec max(Vec a, Vec b) { return _mm_max_epi32(a, b); }
+	static void store(int * p, Vec v) { storeInt(p, v); }
+	static FloatVec toFloat(const int * p) { return _mm_cvtepi32_ps(loadInt(p)); }
+};
+template <> struct SimdOps<float>
+{
+	typedef FloatVec Vec;
+	static Vec load(const float * p) { return _mm_loadu_ps(p); }
+	static Vec min(Vec a, Vec b) { return _mm_min_ps(a, b); }
+	static Vec max(Vec a, Vec b) { return _mm_max_ps(a, b); }
+	static void store(float * p, Vec v) { _mm_storeu_ps(p, v); }
+	static FloatVec toFloat(const float * p) { return _mm_loadu_ps(p); }
+};
+
+static inline FloatVec splat(float x) { return _mm_set1_ps(x); }
+static inline FloatVec subf(FloatVec a, FloatVec b) { return _mm_sub_ps(a, b); }
+static inline FloatVec mulf(FloatVec a, FloatVec b) { return _mm_mul_ps(a, b); }
+static inline FloatVec divf(FloatVec a, FloatVec b) { return _mm_div_ps(a, b); }
+static inline IntVec truncate(FloatVec f) { return _mm_cvttps_epi32(f); }
+
+// Packs four vectors of 4 int32 in [0, 255] into 16 ordered bytes.
+static inline void storeBytes(unsigned char * out, const IntVec q[4])
+{
+	storeInt(out, _mm_packus_epi16(_mm_packus_epi32(q[0], q[1]), _mm_packus_epi32(q[2], q[3])));
+}
+#endif
+
+template <typename T>
+static void rangeKernel(const T * v, size_t n, T & out_min, T & out_max)
+{
+	size_t i = 0;
+	T lo = v[0], hi = v[0];
+#if defined(VOLUMEPREP_AVX2) || defined(VOLUMEPREP_SSE41)
+	typedef SimdOps<T> Ops;
+	const size_t lanes = sizeof(typename Ops::Vec) / sizeof(T);
+	if (n >= lanes) {
+		typename Ops::Vec vmin = Ops::load(v);
+		typename Ops::Vec vmax = vmin;
+		for (; i + lanes <= n; i += lanes) {
+			typename Ops::Vec x = Ops::load(v + i);
+			vmin = Ops::min(vmin, x);
+			vmax = Ops::max(vmax, x);
+		}
+		T mins[sizeof(typename Ops::Vec) / sizeof(T)];
+		T maxs[sizeof(typename Ops::Vec) / sizeof(T)];
+		Ops::store(mins, vmin);
+		Ops::store(maxs, vmax);
+		lo = *std::min_element(mins, mins + lanes);
+		hi = *std::max_element(maxs, maxs + lanes);
+	}
+#endif
+	for (; i < n; i++) {
+		lo = std::min(lo, v[i]);
+		hi = std::max(hi, v[i]);
+	}
+	out_min = lo;
+	out_max = hi;
+}
+
+template <typename T>
+static void quantizeKernel(const T * v, size_t n, float min, float extent, unsigned char * out)
+{
+	size_t i = 0;
+#if defined(VOLUMEPREP_AVX2) || defined(VOLUMEPREP_SSE41)
+	const FloatVec vmin = splat(min);
+	const FloatVec vext = splat(extent);
+	const FloatVec v255 = splat(255.0f);
+	for (; i + 4 * kFloatLanes <= n; i += 4 * kFloatLanes) {
+		IntVec q[4];
+		for (size_t k = 0; k < 4; k++) {
+			FloatVec f = SimdOps<T>::toFloat(v + i + kFloatLanes * k);
+			q[k] = truncate(mulf(v255, divf(subf(f, vmin), vext)));
+		}
+		storeBytes(out + i, q);
+	}
+#endif
+	for (; i < n; i++) {
+		float r = 255 * ((v[i] - min) / extent);
+		// NaN voxels (float volumes only) quantize to 0 like the SIMD path.
+		out[i] = r == r ? (unsigned char)(unsigned int)r : 0;
+	}
+}
+
+template <typename T>
+VolumeRange computeRange(const T * voxels, size_t count)
+{
+	VolumeRange range = { 0.0f, 0.0f };
+	if (count == 0)
+		return range;
+
+	std::vector<T> mins(parallelChunkCount(count, kVoxelGrain), voxels[0]);
+	std::vector<T> maxs(mins.size(), voxels[0]);
+	parallelFor(0, count, kVoxelGrain, [&](size_t b, size_t e, size_t chunk) {
+		if (e > b)
+			rangeKernel(voxels + b, e - b, mins[chunk], maxs[chunk]);
+	});
+	range.min = (float)*std::min_element(mins.begin(), mins.end());
+	range.max = (float)*std::max_element(maxs.begin(), maxs.end());
+	return range;
+}
+
+template <typename T>
+void quantizeVolume(const T * voxels, size_t count, VolumeRange range, unsigned char * out)
+{
+	float extent = range.max - range.min;
+	if (extent <= 0.0f) {
+		std::fill(out, out + count, (unsigned char)0);
+		return;
+	}
+	parallelFor(0, count, kVoxelGrain, [&](size_t b, size_t e, size_t) {
+		quantizeKernel(voxels + b, e - b, range.min, extent, out + b);
+	});
+}
+
+template VolumeRange computeRange<unsigned char>(const unsigned char *, size_t);
+template VolumeRange computeRange<unsigned short>(const unsigned short *, size_t);
+template VolumeRange computeRange<int>(const int *, size_t);
+template VolumeRange computeRange<float>(const float *, size_t);
+template void quantizeVolume<unsigned char>(const unsigned char *, size_t, VolumeRange, unsigned char *);
+template void quantizeVolume<unsigned short>(const unsigned short *, size_t, VolumeRange, unsigned char *);
+template void quantizeVolume<int>(const int *, size_t, VolumeRange, unsigned char *);
+template void quantizeVolume<float>(const float *, size_t, VolumeRange, unsigned char *);
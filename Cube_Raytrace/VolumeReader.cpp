@@ -0,0 +1,41 @@
+#include <stdio.h>
+#include <cstring>
+
+#include "volumereader.hpp"
+
+bool parseVoxelType(const char * name, VoxelType & out_type)
+{
+	if (strcmp(name, "uint8") == 0 || strcmp(name, "GL_UNSIGNED_BYTE") == 0)
+		out_type = VoxelType::UInt8;
+	else if (strcmp(name, "uint16") == 0 || strcmp(name, "GL_UNSIGNED_SHORT") == 0)
+		out_type = VoxelType::UInt16;
+	else if (strcmp(name, "int32") == 0 || strcmp(name, "GL_INT") == 0)
+		out_type = VoxelType::Int32;
+	else if (strcmp(name, "float32") == 0 || strcmp(name, "GL_FLOAT") == 0)
+		out_type = VoxelType::Float32;
+	else
+		return false;
+	return true;
+}
+
+const char* voxelTypeName(VoxelType type)
+{
+	switch (type) {
+	case VoxelType::UInt8: return "uint8";
+	case VoxelType::UInt16: return "uint16";
+	case VoxelType::Int32: return "int32";
+	case VoxelType::Float32: return "float32";
+	}
+	return "unknown";
+}
+
+size_t voxelSize(VoxelType type)
+{
+	switch (type) {
+	case VoxelType::UInt8: return 1;
+	case VoxelType::UInt16: return 2;
+	case VoxelType::Int32: return 4;
+	case VoxelType::Float32: return 4;
+	}
+	return 0;
+}
@@ -0,0 +1,114 @@
+#include <stdio.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "volumesource.hpp"
+
+// Memory-mapped volume input.
+// A 20 GB volume is never read up front: the mapping is created in constant
+// time and the normalization/upload passes stream through it, letting the
+// page cache do the I/O. Huge pages are requested where the kernel supports
+// them for file mappings to keep TLB misses down on the long linear scans.
+
+bool mapVolume(
+	const char * path,
+	VolumeSource & out_source,
+	VolumeAccess access
+) {
+	out_source = VolumeSource();
+#ifdef _WIN32
+	DWORD flags = access == VolumeAccess::Sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS;
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, flags, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		printf("Impossible to open the volume %s\n", path);
+		return false;
+	}
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+		printf("Volume %s is empty\n", path);
+		CloseHandle(file);
+		return false;
+	}
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL) {
+		printf("Failed to map volume %s\n", path);
+		CloseHandle(file);
+		return false;
+	}
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == NULL) {
+		printf("Failed to map volume %s\n", path);
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+	out_source.data = (const unsigned char*)view;
+	out_source.size = (size_t)fileSize.QuadPart;
+	out_source.file = file;
+	out_source.mapping = mapping;
+#else
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		printf("Impossible to open the volume %s\n", path);
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		printf("Volume %s is empty\n", path);
+		close(fd);
+		return false;
+	}
+	void* view = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (view == MAP_FAILED) {
+		printf("Failed to map volume %s\n", path);
+		close(fd);
+		return false;
+	}
+	out_source.data = (const unsigned char*)view;
+	out_source.size = (size_t)st.st_size;
+	out_source.fd = fd;
+	adviseVolume(out_source, access);
+#endif
+	return true;
+}
+
+void adviseVolume(const VolumeSource & source, VolumeAccess access)
+{
+#ifndef _WIN32
+	if (source.data == nullptr)
+		return;
+	void* addr = (void*)source.data;
+	madvise(addr, source.size, access == VolumeAccess::Sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+#ifdef MADV_HUGEPAGE
+	// Only honoured for file mappings on kernels with read-only THP for
+	// page cache; silently ignored elsewhere.
+	madvise(addr, source.size, MADV_HUGEPAGE);
+#endif
+#else
+	(void)source;
+	(void)access;
+#endif
+}
+
+void unmapVolume(VolumeSource & source)
+{
+	if (source.data == nullptr)
+		return;
+#ifdef _WIN32
+	UnmapViewOfFile(source.data);
+	CloseHandle((HANDLE)source.mapping);
+	CloseHandle((HANDLE)source.file);
+#else
+	munmap((void*)source.data, source.size);
+	close(source.fd);
+#endif
+	source = VolumeSource();
+}
@@ -0,0 +1,275 @@
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "parallel.hpp"
+#include "renderer.hpp"
+#include "volumetexture.hpp"
+
+// Native-precision volume upload.
+// The texture is allocated once and filled with glTexSubImage3D in slabs of
+// whole slices so the driver never needs a staging copy of the entire
+// volume; uint8/uint16/float32 slabs point straight into the file mapping.
+
+static const size_t kSlabBytes = 64 * 1024 * 1024;
+static const int kMacroCellSize = 8;
+
+VolumeTextureFormat selectVolumeTextureFormat(VoxelType type, bool halfFloat)
+{
+	switch (type) {
+	case VoxelType::UInt8:
+		return { GL_R8, GL_RED, GL_UNSIGNED_BYTE, 1, 255.0f, "GL_R8" };
+	case VoxelType::UInt16:
+		return { GL_R16, GL_RED, GL_UNSIGNED_SHORT, 2, 65535.0f, "GL_R16" };
+	case VoxelType::Int32:
+	case VoxelType::Float32:
+		if (halfFloat)
+			return { GL_R16F, GL_RED, GL_FLOAT, 2, 1.0f, "GL_R16F" };
+		return { GL_R32F, GL_RED, GL_FLOAT, 4, 1.0f, "GL_R32F" };
+	}
+	return { GL_R8, GL_RED, GL_UNSIGNED_BYTE, 1, 255.0f, "GL_R8" };
+}
+
+// Uploads size[] texels of the given mip level at offset[] from src, laid
+// out as described by the current unpack state.
+template <typename T>
+static void uploadRegion(const T * src, size_t, int level, const int offset[3], const int size[3], std::vector<float> &)
+{
+	GLenum type = selectVolumeTextureFormat(VoxelTraits<T>::type, false).type;
+	GLCall(glTexSubImage3D(GL_TEXTURE_3D, level, offset[0], offset[1], offset[2], size[0], size[1], size[2], GL_RED, type, src));
+}
+
+// int32 has no filterable texture format; convert the count source voxels
+// to float first.
+static void uploadRegion(const int * src, size_t count, int level, const int offset[3], const int size[3], std::vector<float> & staging)
+{
+	staging.resize(count);
+	parallelFor(0, count, 1 << 16, [&](size_t b, size_t e, size_t) {
+		for (size_t i = b; i < e; i++)
+			staging[i] = (float)src[i];
+	});
+	GLCall(glTexSubImage3D(GL_TEXTURE_3D, level, offset[0], offset[1], offset[2], size[0], size[1], size[2], GL_RED, GL_FLOAT, staging.data()));
+}
+
+static void allocateVolumeTexture(VolumeTexture & texture)
+{
+	GLCall(glGenTextures(1, &texture.id));
+	GLCall(glBindTexture(GL_TEXTURE_3D, texture.id));
+	GLCall(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER));
+	GLCall(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER));
+	GLCall(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_BORDER));
+	GLCall(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, texture.levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR));
+	GLCall(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+	GLCall(glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAX_LEVEL, texture.levels - 1));
+	GLCall(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+	texture.residentBytes = 0;
+	int dims[3] = { texture.dims[0], texture.dims[1], texture.dims[2] };
+	for (int level = 0; level < texture.levels; level++)
+	{
+		GLCall(glTexImage3D(GL_TEXTURE_3D, level, texture.format.internalFormat, dims[0], dims[1], dims[2], 0,
+			texture.format.format, texture.format.type, nullptr));
+		texture.residentBytes += (size_t)dims[0] * dims[1] * dims[2] * texture.format.bytesPerTexel;
+		for (int a = 0; a < 3; a++)
+			dims[a] = std::max(1, dims[a] / 2);
+	}
+}
+
+static void uploadGradients(const GradientVolume & gradients, double buildMs, VolumeTexture & texture)
+{
+	texture.gradientId = createGradientTexture(gradients);
+	texture.gradientFormat = gradients.format;
+	texture.gradientScale = gradients.maxMagnitude / texture.format.valueScale;
+	size_t bytes = gradients.texels.size() * sizeof(uint32_t);
+	texture.residentBytes += bytes;
+	printf("Gradients %s %s in %.1f ms: %.1f MB resident\n", gradientFilterName(gradients.filter), gradientFormatName(gradients.format),
+		buildMs, bytes / (1024.0 * 1024.0));
+}
+
+static void reportVolumeTexture(const VolumeTexture & texture)
+{
+	printf("Volume texture %s %dx%dx%d, %d levels: %.1f MB resident\n", texture.format.name,
+		texture.dims[0], texture.dims[1], texture.dims[2], texture.levels, texture.residentBytes / (1024.0 * 1024.0));
+}
+
+template <typename T>
+static bool createVolumeTextureAs(
+	const char * path,
+	int dx, int dy, int dz,
+	bool halfFloat,
+	MipFilter mips,
+	const GradientSettings & gradients,
+	VolumeTexture & out_texture
+) {
+	VolumeReader<T> reader;
+	if (!reader.open(path, dx, dy, dz))
+		return false;
+
+	VolumeTexture texture;
+	texture.dims[0] = dx;
+	texture.dims[1] = dy;
+	texture.dims[2] = dz;
+	texture.format = selectVolumeTextureFormat(VoxelTraits<T>::type, halfFloat);
+	texture.range = reader.range();
+	VolumeMip<T> mip;
+	ingestVolumeMip(path, reader.voxels(), dx, dy, dz, mips, mip);
+	texture.levels = mip.levelCount();
+	buildMacroCells(reader.voxels(), dx, dy, dz, kMacroCellSize, texture.cells);
+	allocateVolumeTexture(texture);
+
+	size_t sliceVoxels = (size_t)dx * dy;
+	int slabSlices = (int)std::max<size_t>(1, kSlabBytes / (sliceVoxels * sizeof(T)));
+	std::vector<float> staging;
+	for (int z = 0; z < dz; z += slabSlices)
+	{
+		int offset[3] = { 0, 0, z };
+		int size[3] = { dx, dy, std::min(slabSlices, dz - z) };
+		uploadRegion(reader.voxels() + z * sliceVoxels, size[2] * sliceVoxels, 0, offset, size, staging);
+	}
+	for (int level = 1; level < texture.levels; level++)
+	{
+		int offset[3] = { 0, 0, 0 };
+		const int* size = mip.levelDims(level);
+		uploadRegion(mip.levelData(level), (size_t)size[0] * size[1] * size[2], level, offset, size, staging);
+	}
+	GLCall(glBindTexture(GL_TEXTURE_3D, 0));
+	if (gradients.enabled) {
+		auto start = std::chrono::steady_clock::now();
+		GradientVolume gradientVolume;
+		buildGradientVolume(reader.voxels(), dx, dy, dz, gradients.filter, gradients.format, gradientVolume);
+		uploadGradients(gradientVolume, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(), texture);
+	}
+
+	reportVolumeTexture(texture);
+	out_texture = texture;
+	return true;
+}
+
+// Only the selected bricks are read from the file. The unpack state skips
+// the apron so each brick's interior lands at its place in the texture;
+// skipped bricks are filled with the volume minimum, which is transparent
+// under any window that made them skippable.
+template <typename T>
+static void uploadBricks(
+	const BrickVolume & volume,
+	const std::vector<int> & bricks,
+	VolumeTexture & texture
+) {
+	const BrickVolumeHeader& header = *volume.header;
+	int stored = brickStoredSize(header);
+	size_t storedVoxels = (size_t)stored * stored * stored;
+	std::vector<T> fill(storedVoxels, (T)texture.range.min);
+	std::vector<bool> selected(brickCount(header), false);
+	for (int index : bricks)
+		selected[index] = true;
+
+	GLCall(glPixelStorei(GL_UNPACK_ROW_LENGTH, stored));
+	GLCall(glPixelStorei(GL_UNPACK_IMAGE_HEIGHT, stored));
+	GLCall(glPixelStorei(GL_UNPACK_SKIP_PIXELS, header.apron));
+	GLCall(glPixelStorei(GL_UNPACK_SKIP_ROWS, header.apron));
+	GLCall(glPixelStorei(GL_UNPACK_SKIP_IMAGES, header.apron));
+	std::vector<float> staging;
+	std::vector<int> order = bricks;
+	for (size_t i = 0; i < brickCount(header); i++)
+		if (!selected[i])
+			order.push_back((int)i);
+	for (int index : order)
+	{
+		int coord[3] = {
+			index % (int)header.bricks[0],
+			(index / (int)header.bricks[0]) % (int)header.bricks[1],
+			index / (int)(header.bricks[0] * header.bricks[1])
+		};
+		int offset[3], size[3];
+		for (int a = 0; a < 3; a++)
+		{
+			offset[a] = coord[a] * header.brickSize;
+			size[a] = std::min((int)header.brickSize, (int)header.dims[a] - offset[a]);
+		}
+		const T* src = selected[index] ? (const T*)brickData(volume, index) : fill.data();
+		uploadRegion(src, storedVoxels, 0, offset, size, staging);
+	}
+	GLCall(glPixelStorei(GL_UNPACK_ROW_LENGTH, 0));
+	GLCall(glPixelStorei(GL_UNPACK_IMAGE_HEIGHT, 0));
+	GLCall(glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0));
+	GLCall(glPixelStorei(GL_UNPACK_SKIP_ROWS, 0));
+	GLCall(glPixelStorei(GL_UNPACK_SKIP_IMAGES, 0));
+}
+
+bool createVolumeTexture(
+	const BrickVolume & volume,
+	float minVisible,
+	bool halfFloat,
+	const GradientSettings & gradients,
+	VolumeTexture & out_texture
+) {
+	const BrickVolumeHeader& header = *volume.header;
+	VoxelType type = (VoxelType)header.voxelType;
+	VolumeTexture texture;
+	for (int a = 0; a < 3; a++)
+		texture.dims[a] = (int)header.dims[a];
+	texture.format = selectVolumeTextureFormat(type, halfFloat);
+	texture.range = brickVolumeRange(volume);
+	macroCellsFromBricks(volume, texture.cells);
+	allocateVolumeTexture(texture);
+
+	const float roiMin[3] = { 0.0f, 0.0f, 0.0f };
+	const float roiMax[3] = { 1.0f, 1.0f, 1.0f };
+	std::vector<int> bricks;
+	selectBricks(volume, minVisible, roiMin, roiMax, bricks);
+	switch (type) {
+	case VoxelType::UInt8: uploadBricks<unsigned char>(volume, bricks, texture); break;
+	case VoxelType::UInt16: uploadBricks<unsigned short>(volume, bricks, texture); break;
+	case VoxelType::Int32: uploadBricks<int>(volume, bricks, texture); break;
+	case VoxelType::Float32: uploadBricks<float>(volume, bricks, texture); break;
+	}
+	GLCall(glBindTexture(GL_TEXTURE_3D, 0));
+	if (gradients.enabled) {
+		auto start = std::chrono::steady_clock::now();
+		GradientVolume gradientVolume;
+		if (buildGradientVolume(volume, bricks, gradients.filter, gradients.format, gradientVolume))
+			uploadGradients(gradientVolume, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(), texture);
+	}
+
+	printf("Fetched %zu of %zu bricks\n", bricks.size(), brickCount(header));
+	reportVolumeTexture(texture);
+	out_texture = texture;
+	return true;
+}
+
+bool createVolumeTexture(
+	const char * path,
+	int dx, int dy, int dz,
+	VoxelType type,
+	bool halfFloat,
+	MipFilter mips,
+	const GradientSettings & gradients,
+	VolumeTexture & out_texture
+) {
+	switch (type) {
+	case VoxelType::UInt8: return createVolumeTextureAs<unsigned char>(path, dx, dy, dz, halfFloat, mips, gradients, out_texture);
+	case VoxelType::UInt16: return createVolumeTextureAs<unsigned short>(path, dx, dy, dz, halfFloat, mips, gradients, out_texture);
+	case VoxelType::Int32: return createVolumeTextureAs<int>(path, dx, dy, dz, halfFloat, mips, gradients, out_texture);
+	case VoxelType::Float32: return createVolumeTextureAs<float>(path, dx, dy, dz, halfFloat, mips, gradients, out_texture);
+	}
+	return false;
+}
+
+void deleteVolumeTexture(VolumeTexture & texture)
+{
+	if (texture.id != 0) {
+		GLCall(glDeleteTextures(1, &texture.id));
+	}
+	if (texture.gradientId != 0) {
+		GLCall(glDeleteTextures(1, &texture.gradientId));
+	}
+	texture = VolumeTexture();
+}
+
+void windowUniforms(const VolumeTexture & texture, float level, float width, float & out_low, float & out_scale)
+{
+	if (width <= 0.0f)
+		width = 1.0f;
+	out_low = (level - 0.5f * width) / texture.format.valueScale;
+	out_scale = texture.format.valueScale / width;
+}
@@ -0,0 +1,26 @@
+#ifndef BATCHRENDER_H
+#define BATCHRENDER_H
+#include <vector>
+
+// One camera of a batch, as the column-major object-to-clip matrix the CPU
+// raycaster takes.
+struct BatchView
+{
+	float model[16];
+};
+
+// Reads a view list, one view per line; blank lines and # comments are
+// skipped.
+//   model m0 ... m15          column-major object-to-clip matrix
+//   view ex ey ez [ux uy uz]  looks from the eye at the volume's centre,
+//                             with +y (or u) up on screen
+// The projection is orthographic, so only the direction of the eye counts.
+bool readViewList(const char * path, std::vector<BatchView> & out_views);
+
+// Raytrace volume.raw dx dy dz type batch=views.txt [out=dir] [size=n]
+//     [encoders=n] [tile=n] [workers=n] [layout=linear|blocked|morton]
+// Renders every view of the list on the CPU, without a window or GL
+// context, to dir/view_0000.png and on. While view N+1 is traced, encoder
+// threads compress and write view N; the run ends with views per second.
+int runBatch(int argc, char * argv[]);
+#endif
@@ -0,0 +1,86 @@
+#ifndef BRICKATLAS_H
+#define BRICKATLAS_H
+#include <stdint.h>
+#include <cstddef>
+#include <list>
+#include <utility>
+#include <vector>
+
+#include "brickcache.hpp"
+#include "volumetexture.hpp"
+
+struct BrickAtlasStats
+{
+	uint64_t uploads = 0;
+	uint64_t evictions = 0;
+	size_t wanted = 0;
+	size_t resident = 0;
+};
+
+// Out-of-core paging of a bricked volume.
+// A fixed-size 3D texture holds slotsPerAxis^3 bricks (apron included, so
+// trilinear filtering never crosses into a neighbouring slot). A page
+// table texture with one RGBA8UI texel per brick gives the raymarcher the
+// slot of each resident brick (xyz) and whether it is resident (w).
+// Slots are recycled least recently used first; bricks come through a
+// BrickCache so re-requests after an eviction skip the mapping.
+class BrickAtlas
+{
+public:
+	BrickAtlas(const BrickVolume & volume, size_t budgetBytes, size_t cacheBricks, bool halfFloat);
+	~BrickAtlas();
+	BrickAtlas(const BrickAtlas&) = delete;
+	BrickAtlas& operator=(const BrickAtlas&) = delete;
+
+	// Pages in the non-transparent bricks (max above minVisible, data units)
+	// nearest to eye, given in volume coordinates [0, 1], uploading at most
+	// maxUploads bricks so a single frame's cost stays bounded. The bricks
+	// are only re-sorted when minVisible or the eye changes.
+	void update(const float eye[3], float minVisible, int maxUploads);
+
+	unsigned int atlasTexture() const { return m_Atlas; }
+	unsigned int pageTableTexture() const { return m_PageTable; }
+	const VolumeTextureFormat& format() const { return m_Format; }
+	int slotsPerAxis() const { return m_SlotsPerAxis; }
+	int atlasSize() const { return m_SlotsPerAxis * brickStoredSize(*m_Volume.header); }
+	size_t residentBytes() const;
+	const BrickAtlasStats& stats() const { return m_Stats; }
+	const BrickCache& cache() const { return m_Cache; }
+
+private:
+	struct Slot
+	{
+		int brick = -1;
+		std::list<int>::iterator lru;
+	};
+
+	void orderSelected(const float eye[3]);
+	void upload(int brick, int slot);
+	void setPageEntry(int brick, int slot);
+	void flushPageTable();
+
+	const BrickVolume& m_Volume;
+	BrickCache m_Cache;
+	VolumeTextureFormat m_Format;
+	int m_SlotsPerAxis = 1;
+	unsigned int m_Atlas = 0;
+	unsigned int m_PageTable = 0;
+
+	std::vector<Slot> m_Slots;
+	std::list<int> m_SlotLru;
+	std::vector<int> m_BrickSlot;
+	std::vector<unsigned char> m_PageEntries;
+	int m_DirtyZ[2] = { 0, -1 };
+
+	float m_SelectedThreshold = 0.0f;
+	bool m_HaveSelection = false;
+	std::vector<int> m_Selected;
+	// Selected bricks by squared distance to m_OrderEye; the first m_Wanted
+	// are the nearest and get slots.
+	std::vector<std::pair<float, int>> m_Order;
+	size_t m_Wanted = 0;
+	float m_OrderEye[3] = { 0.0f, 0.0f, 0.0f };
+	bool m_HaveOrder = false;
+	BrickAtlasStats m_Stats;
+};
+#endif
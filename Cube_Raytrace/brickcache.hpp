@@ -0,0 +1,49 @@
+#ifndef BRICKCACHE_H
+#define BRICKCACHE_H
+#include <stdint.h>
+#include <cstddef>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#include "brickvolume.hpp"
+
+struct BrickCacheStats
+{
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+	uint64_t evictions = 0;
+};
+
+// CPU-side LRU cache of bricks decoded into their upload format (the native
+// voxel type, int32 converted to float), bounded to capacity bricks.
+// A miss copies the brick out of the .bvol mapping, so only cached bricks
+// and the pages the kernel keeps around occupy memory.
+class BrickCache
+{
+public:
+	BrickCache(const BrickVolume & volume, size_t capacity);
+
+	// Returns the decoded brick, valid until the next fetch().
+	const void* fetch(int index);
+
+	size_t capacity() const { return m_Capacity; }
+	size_t size() const { return m_Entries.size(); }
+	size_t decodedBytes() const { return m_DecodedBytes; }
+	const BrickCacheStats& stats() const { return m_Stats; }
+
+private:
+	struct Entry
+	{
+		std::list<int>::iterator lru;
+		std::vector<unsigned char> data;
+	};
+
+	const BrickVolume& m_Volume;
+	size_t m_Capacity;
+	size_t m_DecodedBytes;
+	std::list<int> m_Lru;
+	std::unordered_map<int, Entry> m_Entries;
+	BrickCacheStats m_Stats;
+};
+#endif
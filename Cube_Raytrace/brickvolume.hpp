@@ -0,0 +1,91 @@
+#ifndef BRICKVOLUME_H
+#define BRICKVOLUME_H
+#include <stdint.h>
+#include <cstddef>
+#include <vector>
+
+#include "volumereader.hpp"
+#include "volumesource.hpp"
+
+// Bricked volume file (.bvol).
+//
+//   BrickVolumeHeader
+//   BrickInfo[bricks.x * bricks.y * bricks.z]   indexed bx + nx * (by + ny * bz)
+//   brick payloads, Z-ordered, each padded to kBrickAlignment
+//
+// A brick stores (brickSize + 2 * apron)^3 voxels of voxelType, x fastest;
+// the apron duplicates neighbouring voxels (clamped at the volume edge) so
+// a brick can be filtered on its own. min/max cover the whole stored brick
+// including the apron, mean only its interior.
+
+static const char kBrickMagic[4] = { 'B', 'V', 'O', 'L' };
+static const uint32_t kBrickVersion = 1;
+static const uint64_t kBrickAlignment = 4096;
+
+struct BrickVolumeHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t dims[3];
+	uint32_t voxelType;
+	uint32_t brickSize;
+	uint32_t apron;
+	uint32_t bricks[3];
+	uint32_t reserved;
+	uint64_t brickTableOffset;
+	uint64_t dataOffset;
+};
+
+struct BrickInfo
+{
+	float min;
+	float max;
+	float mean;
+	uint32_t zorder;
+	uint64_t offset;
+};
+
+static_assert(sizeof(BrickVolumeHeader) == 64, "BrickVolumeHeader layout");
+static_assert(sizeof(BrickInfo) == 24, "BrickInfo layout");
+
+// Builds a .bvol from a raw volume, one brick per task across all cores.
+bool convertToBricks(
+	const char * rawPath,
+	int dx, int dy, int dz,
+	VoxelType type,
+	const char * outPath,
+	int brickSize,
+	int apron = 1
+);
+
+// Read-only mapping of a .bvol; brick payloads are paged in on first touch.
+struct BrickVolume
+{
+	VolumeSource source;
+	const BrickVolumeHeader* header = nullptr;
+	const BrickInfo* table = nullptr;
+};
+
+bool openBrickVolume(const char * path, BrickVolume & out_volume);
+void closeBrickVolume(BrickVolume & volume);
+
+size_t brickCount(const BrickVolumeHeader & header);
+int brickIndex(const BrickVolumeHeader & header, int bx, int by, int bz);
+// Edge length of a stored brick, apron included.
+int brickStoredSize(const BrickVolumeHeader & header);
+size_t brickBytes(const BrickVolumeHeader & header);
+const void* brickData(const BrickVolume & volume, int index);
+VolumeRange brickVolumeRange(const BrickVolume & volume);
+
+// Bricks a view needs: those overlapping the [roiMin, roiMax] box (volume
+// coordinates in [0, 1]) whose max exceeds minVisible, i.e. that are not
+// fully transparent under the current window. Returned in file (Z) order
+// so the reads stream forward through the mapping.
+void selectBricks(
+	const BrickVolume & volume,
+	float minVisible,
+	const float roiMin[3],
+	const float roiMax[3],
+	std::vector<int> & out_bricks
+);
+#endif
@@ -0,0 +1,68 @@
+#ifndef CPURAYCASTER_H
+#define CPURAYCASTER_H
+#include <cstddef>
+#include <vector>
+
+#include "tilescheduler.hpp"
+#include "volumelayout.hpp"
+#include "volumeprep.hpp"
+
+// Volume as the CPU raycaster samples it: the windowed value of every
+// voxel, unclamped, so that filtering and then clamping gives what the
+// shader gets from textureLod followed by sampleWindowed. A one-voxel
+// border holds the windowed value of the GL_CLAMP_TO_BORDER border (0).
+// The bordered grid is stored in any VoxelLayout; rays that do not run
+// along x sample fewer cache lines from the blocked and Morton ones.
+struct CpuVolume
+{
+	int dims[3] = { 0, 0, 0 };
+	VoxelGrid grid;
+	std::vector<float> values;
+};
+
+// Window [low, high] in data units, as in the viewer.
+template <typename T>
+void prepareCpuVolume(const T * voxels, int dx, int dy, int dz, VolumeRange window, CpuVolume & out, VoxelLayout layout = VoxelLayout::Linear);
+
+struct CpuRaycastSettings
+{
+	int width = 512;
+	int height = 512;
+	// Column-major object-to-clip matrix; the view looks down +z of clip
+	// space with an orthographic projection, as the rasterized ray setup does.
+	float model[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+	// Object-space box the volume fills.
+	float boxMin[3] = { -0.5f, -0.5f, -0.5f };
+	float boxSize[3] = { 1.0f, 1.0f, 1.0f };
+	// Same meaning as u_StepScale, u_Compositing and u_OpacityCutoff.
+	float stepScale = 1.0f;
+	int compositing = 1;
+	float opacityCutoff = 0.0f;
+	// Trace 8-ray packets when built with AVX2.
+	bool packets = true;
+	// Edge of the square tiles handed to the workers; a multiple of 8 keeps
+	// packets full.
+	int tileSize = 16;
+	// Worker threads, workerCount() when 0.
+	unsigned int workers = 0;
+};
+
+// Whether this build traces AVX2 packets (-mavx2 -mfma, /arch:AVX2).
+bool cpuRaycastPackets();
+
+// Renders the composite mode of Basic.shader without skipping, level of
+// detail or adaptive steps: intersect_box, a fixed step, the colormap (up
+// to 256 RGBA8 entries, linearly filtered and clamped like the texture) and
+// front-to-back compositing up to an opacity of 0.95. Tiles are spread
+// over the workers by forEachTile, which also reports into out_stats.
+// out_rgba is width * height RGBA8, top row first, the color premultiplied
+// as it ends up over the black background.
+void cpuRaycast(
+	const CpuVolume & volume,
+	const unsigned char * colormap,
+	int colormapSize,
+	const CpuRaycastSettings & settings,
+	std::vector<unsigned char> & out_rgba,
+	TileStats * out_stats = nullptr
+);
+#endif
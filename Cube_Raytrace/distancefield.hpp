@@ -0,0 +1,48 @@
+#ifndef DISTANCEFIELD_H
+#define DISTANCEFIELD_H
+#include <vector>
+
+#include "macrocells.hpp"
+
+// Empty-space distance field over a macro-cell grid.
+// Every cell stores the Chebyshev (L-infinity) distance, in cells and
+// capped at maxDistance, to the nearest cell whose max exceeds the current
+// threshold; occupied cells store 0. A cell at distance d sits in an empty
+// cube of 2d - 1 cells, so the raymarcher can leap to that cube's exit in
+// one step instead of crossing it cell by cell.
+// The transform is separable: a linear two-way sweep along x, then bounded
+// min-max scans along y and z, each pass split across all cores.
+class DistanceField
+{
+public:
+	DistanceField(const MacroCellGrid & grid, int maxDistance = 15);
+	~DistanceField();
+	DistanceField(const DistanceField&) = delete;
+	DistanceField& operator=(const DistanceField&) = delete;
+
+	// Sets the occupancy threshold (data units). Only the cells within
+	// maxDistance of a cell whose occupancy flipped are recomputed and
+	// uploaded; returns false when nothing changed.
+	bool update(float threshold);
+
+	unsigned int texture() const { return m_Texture; }
+	int maxDistance() const { return m_MaxDistance; }
+	// Wall time of the last update() that did any work, and how many cells
+	// it recomputed.
+	double lastBuildMs() const { return m_LastBuildMs; }
+	size_t lastBuildCells() const { return m_LastBuildCells; }
+
+private:
+	void compute(const int windowMin[3], const int windowMax[3], const int writeMin[3], const int writeMax[3]);
+
+	const MacroCellGrid& m_Grid;
+	int m_MaxDistance;
+	bool m_HaveThreshold = false;
+	float m_Threshold = 0.0f;
+	std::vector<unsigned char> m_Occupied;
+	std::vector<unsigned char> m_Distance;
+	unsigned int m_Texture = 0;
+	double m_LastBuildMs = 0.0;
+	size_t m_LastBuildCells = 0;
+};
+#endif
@@ -0,0 +1,79 @@
+#ifndef DYNAMICRESOLUTION_H
+#define DYNAMICRESOLUTION_H
+#include <cstdint>
+
+struct DynamicResolutionStats
+{
+	// GPU time of the last measured frame and its running average.
+	double lastMs = 0.0;
+	double averageMs = 0.0;
+	// Frames measured, how many of them were drawn below full quality, how
+	// many were accumulation passes or strips of one, and how many went over
+	// the budget.
+	uint64_t frames = 0;
+	uint64_t degradedFrames = 0;
+	uint64_t refinementFrames = 0;
+	uint64_t overBudgetFrames = 0;
+};
+
+// Closed-loop control of the raymarch quality against a GPU frame-time
+// budget. The frame's GPU work is timed with GL_TIME_ELAPSED queries, read
+// back a few frames later without stalling. Each measurement is turned
+// into the cost of a full-quality frame, assuming the cost follows the
+// pixel count over the step factor, and the quality is set so that the
+// next frames take targetFraction of the budget: the render-target scale
+// drops first, down to minScale, then the steps lengthen up to
+// maxStepFactor. Small errors are left alone so the scale does not hunt.
+class DynamicResolution
+{
+public:
+	explicit DynamicResolution(double budgetMs);
+	~DynamicResolution();
+	DynamicResolution(const DynamicResolution&) = delete;
+	DynamicResolution& operator=(const DynamicResolution&) = delete;
+
+	// Bracket the GPU work of a frame drawn at the current scale and step
+	// factor. Frames are skipped while all queries are still in flight.
+	void beginFrame();
+	void endFrame();
+	// Like beginFrame, for a full-quality refinement pass that covers the
+	// given fraction of the window.
+	void beginRefinement(float coverage);
+	// Reads back finished queries and adjusts the quality.
+	void update();
+
+	float scale() const { return m_Scale; }
+	float stepFactor() const { return m_StepFactor; }
+	double budgetMs() const { return m_BudgetMs; }
+	// Estimated GPU time of a whole frame at full quality, 0 until measured.
+	double fullQualityMs() const { return m_FullQualityMs; }
+	const DynamicResolutionStats& stats() const { return m_Stats; }
+
+	float minScale = 0.25f;
+	float maxStepFactor = 2.0f;
+	double targetFraction = 0.9;
+
+private:
+	static const int kQueries = 4;
+
+	struct Query
+	{
+		unsigned int id = 0;
+		bool pending = false;
+		float quality = 1.0f;
+		bool refinement = false;
+	};
+
+	void begin(float quality, bool refinement);
+	void adjust(double fullQualityMs);
+
+	Query m_Queries[kQueries];
+	int m_Next = 0;
+	int m_Active = -1;
+	double m_BudgetMs;
+	double m_FullQualityMs = 0.0;
+	float m_Scale = 1.0f;
+	float m_StepFactor = 1.0f;
+	DynamicResolutionStats m_Stats;
+};
+#endif
@@ -0,0 +1,58 @@
+#ifndef GLCONTEXT_H
+#define GLCONTEXT_H
+#include <memory>
+#include <vector>
+
+// The headless backend talks to EGL (link with -lEGL) and is built on
+// Linux unless GLCONTEXT_NO_EGL is defined.
+#if defined(__linux__) && !defined(GLCONTEXT_NO_EGL)
+#define GLCONTEXT_EGL
+#endif
+
+struct GLFWwindow;
+
+enum class GLContextBackend
+{
+	// A GLFW window; frames go to its default framebuffer.
+	Window,
+	// An EGL context without a window, surfaceless where the driver allows
+	// (Mesa, including llvmpipe on machines without a GPU) and on a 1x1
+	// pbuffer otherwise; frames go to an offscreen framebuffer object.
+	Headless
+};
+
+// OpenGL 3.3 core context and the framebuffer its frames are presented to,
+// so the same render loop runs in a window or without a display.
+class GLContext
+{
+public:
+	virtual ~GLContext() = default;
+
+	virtual GLContextBackend backend() const = 0;
+	// Framebuffer to present frames into: 0 for a window, the offscreen
+	// target when headless.
+	virtual unsigned int framebuffer() const = 0;
+	virtual void framebufferSize(int & width, int & height) const = 0;
+	// Shows the frame and handles pending input, or waits up to waitSeconds
+	// for some when that is positive. Headless there is neither.
+	virtual void present(double waitSeconds = 0.0) = 0;
+	virtual bool shouldClose() const = 0;
+	// Seconds since the context was created.
+	virtual double time() const = 0;
+	// The window to install input callbacks on; nullptr when headless.
+	virtual GLFWwindow* window() const { return nullptr; }
+
+	// A context sharing objects with this one, to be made current on a
+	// worker thread; nullptr when the backend cannot create one.
+	virtual std::unique_ptr<GLContext> createShared() = 0;
+	virtual void makeCurrent() = 0;
+	virtual void releaseCurrent() = 0;
+
+	// The presented frame as RGBA8, top row first.
+	void readPixels(std::vector<unsigned char> & out_rgba) const;
+};
+
+// Creates the context, makes it current on this thread and initializes
+// GLEW; returns nullptr (having said why) when any of that fails.
+std::unique_ptr<GLContext> createGLContext(GLContextBackend backend, int width, int height, const char * title);
+#endif
@@ -0,0 +1,61 @@
+#ifndef GRADIENTVOLUME_H
+#define GRADIENTVOLUME_H
+#include <cstdint>
+#include <vector>
+
+#include "brickvolume.hpp"
+
+// Central differences, or the 3x3x3 Sobel operator (central differences
+// smoothed 1-2-1 across the other two axes), both scaled like a plain
+// difference over two voxels.
+enum class GradientFilter
+{
+	Central,
+	Sobel
+};
+
+// Packing of one gradient in 32 bits.
+// RGBA8 keeps the unit direction in rgb and the magnitude in alpha;
+// RGB10A2 keeps the gradient itself in rgb, its length being the
+// magnitude, at 10 bits per component. Both are relative to maxMagnitude.
+enum class GradientFormat
+{
+	RGBA8,
+	RGB10A2
+};
+
+bool parseGradientFilter(const char * name, GradientFilter & out_filter);
+bool parseGradientFormat(const char * name, GradientFormat & out_format);
+const char* gradientFilterName(GradientFilter filter);
+const char* gradientFormatName(GradientFormat format);
+
+struct GradientSettings
+{
+	bool enabled = false;
+	GradientFilter filter = GradientFilter::Central;
+	GradientFormat format = GradientFormat::RGBA8;
+};
+
+struct GradientVolume
+{
+	GradientFilter filter = GradientFilter::Central;
+	GradientFormat format = GradientFormat::RGBA8;
+	int dims[3] = { 0, 0, 0 };
+	// Longest gradient in the volume, in data units.
+	float maxMagnitude = 0.0f;
+	std::vector<uint32_t> texels;
+};
+
+// Gradients of a raw volume, edges clamped. Slices are spread over all
+// cores. Within a slice each input row is converted once into a rolling
+// window, and the differencing, smoothing and packing take four voxels at
+// a time with SSE2.
+template <typename T>
+void buildGradientVolume(const T * voxels, int dx, int dy, int dz, GradientFilter filter, GradientFormat format, GradientVolume & out);
+// Same over the listed bricks of a bricked volume, taking neighbours from
+// the aprons; the gradients of other bricks stay zero. Needs an apron.
+bool buildGradientVolume(const BrickVolume & volume, const std::vector<int> & bricks, GradientFilter filter, GradientFormat format, GradientVolume & out);
+
+// GL_RGBA8 or GL_RGB10_A2 texture, linearly filtered.
+unsigned int createGradientTexture(const GradientVolume & gradients);
+#endif
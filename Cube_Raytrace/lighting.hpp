@@ -0,0 +1,30 @@
+#ifndef LIGHTING_H
+#define LIGHTING_H
+
+// The Phong model of the lighting demos (diffuse floored at an ambient
+// level plus a white specular lobe, both scaling the material color) as
+// the std140 "Lighting" uniform block of the raymarch shader. Positions
+// are in volume coordinates.
+struct LightingBlock
+{
+	float lightPosition[4] = { 2.0f, 2.0f, 2.0f, 1.0f };
+	float lightColor[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	float ambient = 0.3f;
+	float specularStrength = 0.5f;
+	float shininess = 32.0f;
+	// Only samples more opaque than this are shaded.
+	float shadingThreshold = 0.05f;
+	int enabled = 0;
+	int padding[3] = { 0, 0, 0 };
+};
+
+static_assert(sizeof(LightingBlock) == 64, "LightingBlock must match the std140 layout of the Lighting block");
+
+// Uniform buffer binding point the block is attached to.
+const unsigned int kLightingBinding = 0;
+
+unsigned int createLightingBuffer();
+// Uploads the block and binds the buffer to kLightingBinding.
+void updateLightingBuffer(unsigned int buffer, const LightingBlock & lighting);
+void deleteLightingBuffer(unsigned int buffer);
+#endif
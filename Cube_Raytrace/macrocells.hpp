@@ -0,0 +1,34 @@
+#ifndef MACROCELLS_H
+#define MACROCELLS_H
+#include <cstddef>
+#include <vector>
+
+#include "brickvolume.hpp"
+
+// Coarse min/max grid over a volume for empty-space skipping.
+// Cell c covers voxels [c * cellSize, (c + 1) * cellSize) plus one voxel on
+// every side, which is what trilinear samples taken inside the cell read,
+// so a cell whose max is below the transfer function's first visible value
+// can be stepped over without changing the image.
+struct MacroCellGrid
+{
+	int cellSize = 0;
+	int dims[3] = { 0, 0, 0 };
+	// min, max per cell in data units, x fastest.
+	std::vector<float> minMax;
+
+	size_t cellCount() const { return (size_t)dims[0] * dims[1] * dims[2]; }
+};
+
+// Scans the volume on all cores, one run of cell slices per worker.
+template <typename T>
+void buildMacroCells(const T * voxels, int dx, int dy, int dz, int cellSize, MacroCellGrid & out);
+
+// One cell per brick, straight from the .bvol brick table (its min/max
+// already include the apron).
+void macroCellsFromBricks(const BrickVolume & volume, MacroCellGrid & out);
+
+// Uploads the grid as a GL_RG32F texture with GL_NEAREST filtering. Values
+// are divided by valueScale so the shader compares them with raw samples.
+unsigned int createMacroCellTexture(const MacroCellGrid & grid, float valueScale);
+#endif
@@ -0,0 +1,95 @@
+#ifndef MORTON_H
+#define MORTON_H
+#include <stdint.h>
+
+#if defined(__BMI2__) || (defined(_MSC_VER) && defined(__AVX2__))
+#include <immintrin.h>
+#define MORTON_BMI2
+#endif
+
+// 3D Morton (Z-order) codes, 21 bits per axis, and 2D ones, 16 bits per axis.
+// With BMI2 (-mbmi2, /arch:AVX2) spreading and compacting bits is a single
+// pdep or pext, microcoded and slow on AMD before Zen 3; otherwise the
+// usual shift-and-mask ladders.
+
+inline uint64_t mortonSpread3(uint64_t v)
+{
+#ifdef MORTON_BMI2
+	return _pdep_u64(v, 0x1249249249249249ULL);
+#else
+	v &= 0x1fffff;
+	v = (v | (v << 32)) & 0x1f00000000ffffULL;
+	v = (v | (v << 16)) & 0x1f0000ff0000ffULL;
+	v = (v | (v << 8)) & 0x100f00f00f00f00fULL;
+	v = (v | (v << 4)) & 0x10c30c30c30c30c3ULL;
+	v = (v | (v << 2)) & 0x1249249249249249ULL;
+	return v;
+#endif
+}
+
+inline uint64_t mortonCompact3(uint64_t v)
+{
+#ifdef MORTON_BMI2
+	return _pext_u64(v, 0x1249249249249249ULL);
+#else
+	v &= 0x1249249249249249ULL;
+	v = (v | (v >> 2)) & 0x10c30c30c30c30c3ULL;
+	v = (v | (v >> 4)) & 0x100f00f00f00f00fULL;
+	v = (v | (v >> 8)) & 0x1f0000ff0000ffULL;
+	v = (v | (v >> 16)) & 0x1f00000000ffffULL;
+	v = (v | (v >> 32)) & 0x1fffff;
+	return v;
+#endif
+}
+
+inline uint64_t mortonEncode3(uint32_t x, uint32_t y, uint32_t z)
+{
+	return mortonSpread3(x) | (mortonSpread3(y) << 1) | (mortonSpread3(z) << 2);
+}
+
+inline void mortonDecode3(uint64_t code, uint32_t & x, uint32_t & y, uint32_t & z)
+{
+	x = (uint32_t)mortonCompact3(code);
+	y = (uint32_t)mortonCompact3(code >> 1);
+	z = (uint32_t)mortonCompact3(code >> 2);
+}
+
+inline uint32_t mortonSpread2(uint32_t v)
+{
+#ifdef MORTON_BMI2
+	return _pdep_u32(v, 0x55555555);
+#else
+	v &= 0xffff;
+	v = (v | (v << 8)) & 0x00ff00ff;
+	v = (v | (v << 4)) & 0x0f0f0f0f;
+	v = (v | (v << 2)) & 0x33333333;
+	v = (v | (v << 1)) & 0x55555555;
+	return v;
+#endif
+}
+
+inline uint32_t mortonCompact2(uint32_t v)
+{
+#ifdef MORTON_BMI2
+	return _pext_u32(v, 0x55555555);
+#else
+	v &= 0x55555555;
+	v = (v | (v >> 1)) & 0x33333333;
+	v = (v | (v >> 2)) & 0x0f0f0f0f;
+	v = (v | (v >> 4)) & 0x00ff00ff;
+	v = (v | (v >> 8)) & 0x0000ffff;
+	return v;
+#endif
+}
+
+inline uint32_t mortonEncode2(uint32_t x, uint32_t y)
+{
+	return mortonSpread2(x) | (mortonSpread2(y) << 1);
+}
+
+inline void mortonDecode2(uint32_t code, uint32_t & x, uint32_t & y)
+{
+	x = mortonCompact2(code);
+	y = mortonCompact2(code >> 1);
+}
+#endif
@@ -0,0 +1,47 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+inline unsigned int workerCount()
+{
+	unsigned int n = std::thread::hardware_concurrency();
+	return n == 0 ? 1 : n;
+}
+
+// Number of chunks parallelFor will cut [0, count) into.
+inline size_t parallelChunkCount(size_t count, size_t grain)
+{
+	if (grain == 0)
+		grain = 1;
+	size_t chunks = (count + grain - 1) / grain;
+	return std::max<size_t>(1, std::min<size_t>(chunks, workerCount()));
+}
+
+// Splits [begin, end) into parallelChunkCount() contiguous chunks and runs
+// fn(chunkBegin, chunkEnd, chunkIndex) on each, one thread per chunk.
+// The calling thread takes the last chunk and returns when all are done.
+template <typename Fn>
+void parallelFor(size_t begin, size_t end, size_t grain, Fn fn)
+{
+	if (end <= begin)
+		return;
+	size_t count = end - begin;
+	size_t chunks = parallelChunkCount(count, grain);
+	size_t step = (count + chunks - 1) / chunks;
+
+	std::vector<std::thread> threads;
+	threads.reserve(chunks - 1);
+	for (size_t c = 0; c + 1 < chunks; c++)
+	{
+		size_t b = begin + c * step;
+		size_t e = std::min(end, b + step);
+		threads.emplace_back([=]() { fn(b, e, c); });
+	}
+	fn(std::min(end, begin + (chunks - 1) * step), end, chunks - 1);
+	for (auto& t : threads)
+		t.join();
+}
+#endif
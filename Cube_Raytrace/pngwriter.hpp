@@ -0,0 +1,12 @@
+#ifndef PNGWRITER_H
+#define PNGWRITER_H
+#include <vector>
+
+// Encodes width x height RGBA8 pixels, top row first, as a PNG. Each row
+// takes whichever of the None, Sub, Up and Paeth filters leaves the
+// smallest residuals, and the rows are deflated with a single-probe LZ77
+// match finder and the fixed Huffman codes, which trades some file size
+// against zlib for speed and no library to link.
+void encodePng(int width, int height, const unsigned char * rgba, std::vector<unsigned char> & out_png);
+bool writePng(const char * path, int width, int height, const unsigned char * rgba);
+#endif
@@ -0,0 +1,52 @@
+#ifndef PREINTEGRATION_H
+#define PREINTEGRATION_H
+#include <cstddef>
+#include <vector>
+
+// 1D transfer function over the windowed sample value [0, 1]: RGBA at size
+// evenly spaced values, alpha being the opacity of one voxel of ray.
+struct TransferFunction
+{
+	std::vector<float> rgba;
+
+	int size() const { return (int)(rgba.size() / 4); }
+};
+
+// Colors from an RGBA8 colormap (sampled the way GL_LINEAR reads a
+// colormapWidth x 1 texture); opacity is the value itself from
+// opacityCutoff up and 0 below it.
+void buildTransferFunction(const unsigned char * colormap, int colormapWidth, float opacityCutoff, int size, TransferFunction & out);
+
+// Pre-integrated transfer function.
+// Entry (front, back) holds the premultiplied color and opacity of one
+// voxel of ray whose value runs linearly from front to back, integrated
+// with self-attenuation in |back - front| sub-steps. The raymarcher looks
+// up consecutive sample pairs instead of single samples, so thin features
+// between samples are no longer stepped over and the step can grow without
+// banding. Rows are integrated on all cores; after a change only the
+// entries whose value span touches a changed transfer function entry are
+// recomputed.
+class PreIntegrationTable
+{
+public:
+	PreIntegrationTable();
+	~PreIntegrationTable();
+	PreIntegrationTable(const PreIntegrationTable&) = delete;
+	PreIntegrationTable& operator=(const PreIntegrationTable&) = delete;
+
+	// Brings the table in line with tf, uploading it when anything changed.
+	// Returns the number of entries recomputed.
+	size_t update(const TransferFunction & tf);
+
+	unsigned int texture() const { return m_Texture; }
+	int size() const { return m_Size; }
+	double lastBuildMs() const { return m_LastBuildMs; }
+
+private:
+	int m_Size = 0;
+	TransferFunction m_Built;
+	std::vector<float> m_Table;
+	unsigned int m_Texture = 0;
+	double m_LastBuildMs = 0.0;
+};
+#endif
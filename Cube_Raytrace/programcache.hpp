@@ -0,0 +1,29 @@
+#ifndef PROGRAMCACHE_H
+#define PROGRAMCACHE_H
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// On-disk cache of linked program binaries (ARB_get_program_binary).
+// Each permutation of a .shader file has one slot in shadercache/ under
+// the working directory, shadercache/<file name>.<hash of defines>.bin.
+// The binary is stored with a key hashing the preprocessed stage sources
+// and the driver's vendor, renderer and version strings, so an edited
+// shader or a driver update misses the cache and its save overwrites the
+// stale binary instead of leaving it behind.
+
+// FNV-1a over the sources and the current context's driver strings.
+uint64_t programCacheKey(const std::vector<std::string>& sources);
+std::string programCachePath(const std::string& filepath, const std::vector<std::string>& defines);
+
+// The cache is used when enabled and the driver offers a binary format.
+void setProgramCacheEnabled(bool enabled);
+bool programCacheAvailable();
+
+// Loads a cached binary into program; false when there is none or the
+// driver rejects it, in which case the program is compiled as usual.
+bool loadProgramBinary(const std::string& path, uint64_t key, unsigned int program);
+// Stores a linked program that was created with
+// GL_PROGRAM_BINARY_RETRIEVABLE_HINT set.
+bool saveProgramBinary(const std::string& path, uint64_t key, unsigned int program);
+#endif
@@ -0,0 +1,89 @@
+#ifndef PROGRESSIVE_H
+#define PROGRESSIVE_H
+
+class ShaderProgram;
+
+// Progressive refinement of the raymarch pass.
+// While the view is moving each frame is raymarched into the lower-left
+// 1/2 (or, when that misses the interactive budget, 1/4) of an offscreen
+// target with longer steps and stretched onto the screen, unless a
+// dynamic resolution controller picks the scale and step instead. Once the view
+// holds still, full-resolution passes with a different jitter of the ray
+// start are averaged into an accumulation buffer until maxPasses have
+// been taken; after that the result is presented without raymarching.
+// A full-resolution pass that would take longer than passBudgetMs is
+// drawn as scissored strips of rows, one per frame, sized from passCostMs.
+class ProgressiveRenderer
+{
+public:
+	ProgressiveRenderer();
+	~ProgressiveRenderer();
+	ProgressiveRenderer(const ProgressiveRenderer&) = delete;
+	ProgressiveRenderer& operator=(const ProgressiveRenderer&) = delete;
+
+	// Starts a frame of the given framebuffer size. moving selects the
+	// interactive path, reset restarts accumulation without it (settings
+	// changed); frameMs is the last frame's duration. Returns false when the
+	// image has converged and no pass needs to be drawn.
+	bool beginFrame(int width, int height, bool moving, bool reset, double frameMs);
+	// Binds the offscreen target and viewport of this frame's pass.
+	void bindTarget() const;
+	// Accumulates the pass if any and presents to framebuffer target,
+	// drawing with quadVao (a screen-filling triangle list of 6 vertices).
+	void endFrame(unsigned int quadVao, unsigned int target = 0);
+	// Presents the latest image to target again, without accumulating.
+	void present(unsigned int target = 0) const;
+
+	// Pass parameters: resolution relative to the window, step length
+	// factor and the ray start jitter in [0, 1), negative for none.
+	float scale() const { return m_Scale; }
+	float stepFactor() const { return m_StepFactor; }
+	float jitter() const { return m_Jitter; }
+	int passes() const { return m_Passes; }
+	// Whether this frame's pass is a reduced or unrefined one rather than
+	// an accumulation pass.
+	bool interactive() const { return m_Interactive; }
+	// Fraction of the window's rows this frame's pass covers, less than 1
+	// when an accumulation pass is drawn in strips.
+	float coverage() const { return m_Interactive || m_Height == 0 ? 1.0f : (float)m_StripRows / m_Height; }
+
+	// Disabled, every frame is an interactive one.
+	bool enabled = true;
+	// Scale and step factor of interactive passes when dynamicScale > 0.
+	float dynamicScale = 0.0f;
+	float dynamicStepFactor = 1.0f;
+	int maxPasses = 16;
+	// Interactive frames slower than this drop to 1/4 resolution, faster
+	// than half of it go back to 1/2.
+	double interactiveBudgetMs = 16.0;
+	// GPU time allowed per accumulation frame and the measured time of a
+	// whole full-resolution pass; accumulation passes are split into strips
+	// when both are set and the pass does not fit.
+	double passBudgetMs = 0.0;
+	double passCostMs = 0.0;
+
+private:
+	void allocate(int width, int height);
+
+	unsigned int m_PassFramebuffer = 0;
+	unsigned int m_PassColor = 0;
+	unsigned int m_PassDepth = 0;
+	unsigned int m_AccumFramebuffer = 0;
+	unsigned int m_AccumColor = 0;
+	ShaderProgram* m_Present = nullptr;
+	int m_Width = 0;
+	int m_Height = 0;
+	int m_PassWidth = 0;
+	int m_PassHeight = 0;
+	float m_Scale = 1.0f;
+	float m_StepFactor = 1.0f;
+	int m_InteractiveDivisor = 2;
+	bool m_Interactive = false;
+	bool m_Drawing = false;
+	float m_Jitter = -1.0f;
+	int m_Passes = 0;
+	// Rows of the accumulation pass in progress drawn by this frame.
+	int m_StripY = 0;
+	int m_StripRows = 0;
+};
+#endif
@@ -0,0 +1,59 @@
+#ifndef RAYSETUP_H
+#define RAYSETUP_H
+#include <vector>
+
+#include "macrocells.hpp"
+
+// Rasterized ray setup.
+// Renders bounding geometry into a float framebuffer twice: the nearest
+// surface (depth test GL_LESS) gives each pixel's entry point, the farthest
+// (GL_GREATER against a depth cleared to 0) its exit point, both in volume
+// coordinates [0, 1] with alpha 1 where covered. Depth ordering rather than
+// face culling picks the surfaces, so the winding of the mesh is irrelevant.
+// The raymarch pass then reads both per pixel instead of intersecting a box
+// in every fragment, and pixels the geometry misses never start a ray.
+class RaySetup
+{
+public:
+	RaySetup();
+	~RaySetup();
+	RaySetup(const RaySetup&) = delete;
+	RaySetup& operator=(const RaySetup&) = delete;
+
+	// Object-space triangles, xyz per vertex.
+	void setGeometry(const std::vector<float> & positions);
+	// Reallocates the targets when the framebuffer size changes.
+	void resize(int width, int height);
+	// Renders entry and exit points with program, which maps position
+	// through model and writes volume coordinates; leaves framebuffer 0
+	// bound and the depth state as GL_LESS / clear depth 1.
+	void render(unsigned int program, const float * model);
+
+	unsigned int entryTexture() const { return m_Entry; }
+	unsigned int exitTexture() const { return m_Exit; }
+	int vertexCount() const { return m_VertexCount; }
+
+private:
+	unsigned int m_Framebuffer = 0;
+	unsigned int m_Entry = 0;
+	unsigned int m_Exit = 0;
+	unsigned int m_Depth = 0;
+	unsigned int m_Vao = 0;
+	unsigned int m_Vbo = 0;
+	int m_VertexCount = 0;
+	int m_Width = 0;
+	int m_Height = 0;
+};
+
+// Tight proxy geometry: the boundary faces of the union of macro-cells
+// whose max is above threshold (data units), as object-space triangles
+// given the object-space box [boxMin, boxMin + boxSize] the volume fills.
+void buildProxyGeometry(
+	const MacroCellGrid & grid,
+	const int volumeDims[3],
+	float threshold,
+	const float boxMin[3],
+	const float boxSize[3],
+	std::vector<float> & out_positions
+);
+#endif
@@ -0,0 +1,13 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+#include <GL/glew.h>
+#include <assert.h>
+
+#define ASSERT(x) if (!(x)) assert(false)
+#define GLCall(x) GLClearError();\
+    x;\
+    ASSERT(GLCheckError())
+
+void GLClearError();
+bool GLCheckError();
+#endif
@@ -0,0 +1,63 @@
+#ifndef RENDERMODE_H
+#define RENDERMODE_H
+
+// How the raymarcher turns the samples along a ray into a pixel. Each mode
+// is its own permutation of Basic.shader, selected by the define below.
+enum class RenderMode
+{
+	Composite,
+	MaximumIntensity,
+	MinimumIntensity,
+	Average,
+	Isosurface
+};
+
+const int renderModeCount = 5;
+
+inline const char* renderModeName(RenderMode mode)
+{
+	switch (mode)
+	{
+	case RenderMode::Composite: return "composite";
+	case RenderMode::MaximumIntensity: return "maximum intensity";
+	case RenderMode::MinimumIntensity: return "minimum intensity";
+	case RenderMode::Average: return "average";
+	case RenderMode::Isosurface: return "first-hit isosurface";
+	}
+	return "unknown";
+}
+
+inline const char* renderModeDefine(RenderMode mode)
+{
+	switch (mode)
+	{
+	case RenderMode::Composite: return "RENDER_COMPOSITE";
+	case RenderMode::MaximumIntensity: return "RENDER_MIP";
+	case RenderMode::MinimumIntensity: return "RENDER_MINIP";
+	case RenderMode::Average: return "RENDER_AVERAGE";
+	case RenderMode::Isosurface: return "RENDER_ISOSURFACE";
+	}
+	return "RENDER_COMPOSITE";
+}
+
+// How the composite mode accumulates its samples, a permutation of its own.
+enum class Compositing
+{
+	FrontToBack,
+	PreIntegrated,
+	Legacy
+};
+
+const int compositingCount = 3;
+
+inline const char* compositingDefine(Compositing compositing)
+{
+	switch (compositing)
+	{
+	case Compositing::FrontToBack: return "COMPOSITE_FRONT_TO_BACK";
+	case Compositing::PreIntegrated: return "COMPOSITE_PREINTEGRATED";
+	case Compositing::Legacy: return "COMPOSITE_LEGACY";
+	}
+	return "COMPOSITE_FRONT_TO_BACK";
+}
+#endif
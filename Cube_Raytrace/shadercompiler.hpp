@@ -0,0 +1,56 @@
+#ifndef SHADERCOMPILER_H
+#define SHADERCOMPILER_H
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "glcontext.hpp"
+#include "shaderprogram.hpp"
+
+// Builds shader programs without stalling the render loop. Everything is
+// submitted up front; Get() returns a program once it is linked and
+// nullptr while it is still being built, so the caller can draw with a
+// fallback meanwhile. With KHR_parallel_shader_compile the driver compiles
+// on its own threads and completion is polled; otherwise a worker thread
+// builds the programs on a context shared with the main one. Without
+// either, Submit() builds synchronously.
+class ShaderCompiler
+{
+public:
+	explicit ShaderCompiler(GLContext & context);
+	~ShaderCompiler();
+	ShaderCompiler(const ShaderCompiler&) = delete;
+	ShaderCompiler& operator=(const ShaderCompiler&) = delete;
+
+	// Returns a handle for Get().
+	int Submit(const std::string& filepath, const std::vector<std::string>& defines = std::vector<std::string>());
+	ShaderProgram* Get(int handle);
+	// Whether every submitted program is linked; also finishes those that are.
+	bool Done();
+	int ProgramCount() const { return (int)m_Programs.size(); }
+
+	const char* Mode() const;
+
+private:
+	void WorkerLoop();
+
+	struct Job
+	{
+		std::string filepath;
+		std::vector<std::string> defines;
+	};
+
+	std::vector<std::unique_ptr<ShaderProgram>> m_Programs;
+	std::vector<bool> m_Ready;
+	bool m_Parallel = false;
+	std::unique_ptr<GLContext> m_WorkerContext;
+	std::thread m_Worker;
+	std::mutex m_Mutex;
+	std::condition_variable m_Wake;
+	std::vector<std::pair<int, Job>> m_Queue;
+	bool m_Quit = false;
+};
+#endif
@@ -0,0 +1,74 @@
+#ifndef SHADERPROGRAM_H
+#define SHADERPROGRAM_H
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct ShaderProgramSource
+{
+	std::string VertexSource;
+	std::string FragmentSource;
+};
+
+// Splits a .shader file at its "#shader vertex" / "#shader fragment" lines.
+ShaderProgramSource ParseShader(const std::string& filepath);
+// Inserts a "#define NAME" line per entry right after the #version line, so
+// one source yields compile-time permutations.
+std::string InjectDefines(const std::string& source, const std::vector<std::string>& defines);
+
+// A linked program built from one .shader file and a set of defines.
+// Uniform locations are looked up once per name and cached. Linked
+// programs go through the on-disk binary cache (programcache.hpp).
+// With wait false the constructor only queues the compile and link; with
+// KHR_parallel_shader_compile the driver then builds the program in the
+// background until IsReady(), and Finish() completes it.
+class ShaderProgram
+{
+public:
+	ShaderProgram(const std::string& filepath, const std::vector<std::string>& defines = std::vector<std::string>(), bool wait = true);
+	~ShaderProgram();
+	ShaderProgram(const ShaderProgram&) = delete;
+	ShaderProgram& operator=(const ShaderProgram&) = delete;
+
+	void Bind() const;
+	void Unbind() const;
+	unsigned int GetRendererID() const { return m_RendererID; }
+	// Without the extension IsReady() is always true and Finish() blocks.
+	bool IsReady() const;
+	void Finish();
+	bool IsLinked() const { return m_Linked; }
+	// Whether the program came from the binary cache, and the time it took
+	// to load or compile and link.
+	bool FromCache() const { return m_FromCache; }
+	double BuildMs() const { return m_BuildMs; }
+
+	void SetUniform1i(const std::string& name, int value);
+	void SetUniform1f(const std::string& name, float value);
+	void SetUniform3f(const std::string& name, float v0, float v1, float v2);
+	void SetUniformMat4f(const std::string& name, const float * matrix);
+	// Attaches a uniform block to a buffer binding point; blocks a
+	// permutation compiles out are skipped.
+	void SetUniformBlockBinding(const std::string& name, unsigned int binding);
+
+private:
+	int GetUniformLocation(const std::string& name);
+
+	unsigned int m_RendererID = 0;
+	bool m_Linked = false;
+	bool m_FromCache = false;
+	double m_BuildMs = 0.0;
+	bool m_Pending = false;
+	std::string m_FilePath;
+	std::vector<std::string> m_Defines;
+	std::chrono::steady_clock::time_point m_Start;
+	unsigned int m_VertexShader = 0;
+	unsigned int m_FragmentShader = 0;
+	bool m_Cached = false;
+	uint64_t m_CacheKey = 0;
+	std::string m_CachePath;
+	std::unordered_map<std::string, int> m_UniformLocationCache;
+	std::unordered_map<std::string, unsigned int> m_UniformBlockBindings;
+};
+#endif
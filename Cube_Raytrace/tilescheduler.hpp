@@ -0,0 +1,48 @@
+#ifndef TILESCHEDULER_H
+#define TILESCHEDULER_H
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Pixel rectangle [x0, x1) x [y0, y1).
+struct Tile
+{
+	int x0, y0, x1, y1;
+};
+
+struct TileWorkerStats
+{
+	uint64_t tiles = 0;
+	// Tiles this worker took from other workers' queues, and steal attempts
+	// that found the victim empty.
+	uint64_t stolen = 0;
+	uint64_t failedSteals = 0;
+	// Time spent inside the tile function.
+	double busyMs = 0.0;
+};
+
+struct TileStats
+{
+	double wallMs = 0.0;
+	std::vector<TileWorkerStats> workers;
+
+	// Busy time of worker w (or of all of them, w < 0) over the wall time.
+	double utilization(int w = -1) const;
+};
+
+// Runs fn(tile, worker) over the width x height image cut into tileSize
+// squares, on workers threads (workerCount() when 0; the caller is worker
+// 0). The tiles are ordered along a Morton curve, so consecutive ones are
+// close on screen and in the volume, and every worker starts with an equal
+// contiguous run of that order. A worker takes its own tiles from the
+// front; when it runs out it steals the back half of another worker's
+// remaining run, keeping the stolen tiles contiguous too.
+void forEachTile(
+	int width,
+	int height,
+	int tileSize,
+	const std::function<void(const Tile &, unsigned int)> & fn,
+	TileStats * out_stats = nullptr,
+	unsigned int workers = 0
+);
+#endif
@@ -0,0 +1,31 @@
+// Converts a raw volume into the bricked .bvol format read by the viewer.
+//
+//   g++ -O2 -mavx2 -pthread -I.. BrickConvert.cpp ../BrickVolume.cpp ../VolumeReader.cpp
+//       ../VolumePrep.cpp ../VolumeSource.cpp -o brickconvert
+//   brickconvert input.raw dx dy dz uint8|uint16|int32|float32 output.bvol [brickSize]
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+
+#include "brickvolume.hpp"
+
+int main(int argc, char* argv[])
+{
+	VoxelType type;
+	if (argc < 7 || !parseVoxelType(argv[5], type))
+	{
+		fprintf(stderr, "Usage: %s input.raw dx dy dz uint8|uint16|int32|float32 output.bvol [brickSize]\n", argv[0]);
+		return 1;
+	}
+	int dx = atoi(argv[2]);
+	int dy = atoi(argv[3]);
+	int dz = atoi(argv[4]);
+	int brickSize = argc > 7 ? atoi(argv[7]) : 32;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	if (!convertToBricks(argv[1], dx, dy, dz, type, argv[6], brickSize))
+		return 1;
+	auto stop = std::chrono::high_resolution_clock::now();
+	printf("Converted in %.1f ms\n", std::chrono::duration<double, std::milli>(stop - start).count());
+	return 0;
+}
@@ -0,0 +1,176 @@
+// Renders a raw volume on the CPU, no GL context needed.
+//
+//   g++ -O2 -mavx2 -mfma -pthread -I.. CpuRender.cpp ../CpuRaycaster.cpp ../TileScheduler.cpp ../VolumeLayout.cpp ../VolumeReader.cpp
+//       ../VolumePrep.cpp ../VolumeSource.cpp -o cpurender
+//   cpurender input.raw dx dy dz uint8|uint16|int32|float32 output.pam [size] [angx angy angz]
+//       [compare] [tile=16] [workers=n] [layout=linear|blocked|morton]
+//
+// Writes an RGBA PAM of size x size pixels (512 by default) with the volume
+// rotated by the given angles in radians, in the order the viewer applies
+// them, and colored with res/textures/matplotlib-virdis.png when present.
+// "compare" also traces every ray one at a time and reports how far the
+// packet path strays from it. tile= and workers= set the tile edge and the
+// thread count; the per-worker utilization shows how evenly they scale.
+// layout= stores the volume blocked or in Morton order instead of linearly.
+#define STB_IMAGE_IMPLEMENTATION
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "cpuraycaster.hpp"
+#include "volumereader.hpp"
+#include "vendor/stb_image.h"
+
+template <typename T>
+static bool loadVolume(const char * path, int dx, int dy, int dz, VoxelLayout layout, CpuVolume & out)
+{
+	VolumeReader<T> reader;
+	if (!reader.open(path, dx, dy, dz))
+		return false;
+	prepareCpuVolume(reader.voxels(), dx, dy, dz, reader.range(), out, layout);
+	return true;
+}
+
+// out = a * b, column-major.
+static void multiply(const float a[16], const float b[16], float out[16])
+{
+	float r[16];
+	for (int c = 0; c < 4; c++)
+		for (int i = 0; i < 4; i++)
+			r[c * 4 + i] = a[i] * b[c * 4] + a[4 + i] * b[c * 4 + 1] + a[8 + i] * b[c * 4 + 2] + a[12 + i] * b[c * 4 + 3];
+	memcpy(out, r, sizeof(r));
+}
+
+static void rotation(int axis, float angle, float out[16])
+{
+	static const float identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+	memcpy(out, identity, sizeof(identity));
+	int u = (axis + 1) % 3;
+	int v = (axis + 2) % 3;
+	out[u * 4 + u] = std::cos(angle);
+	out[u * 4 + v] = std::sin(angle);
+	out[v * 4 + u] = -std::sin(angle);
+	out[v * 4 + v] = std::cos(angle);
+}
+
+static bool writePam(const char * path, int width, int height, const std::vector<unsigned char> & rgba)
+{
+	FILE* file = fopen(path, "wb");
+	if (!file)
+		return false;
+	fprintf(file, "P7\nWIDTH %d\nHEIGHT %d\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n", width, height);
+	bool ok = fwrite(rgba.data(), 1, rgba.size(), file) == rgba.size();
+	return fclose(file) == 0 && ok;
+}
+
+int main(int argc, char* argv[])
+{
+	VoxelType type;
+	if (argc < 7 || !parseVoxelType(argv[5], type))
+	{
+		fprintf(stderr, "Usage: %s input.raw dx dy dz uint8|uint16|int32|float32 output.pam [size] [angx angy angz] [compare] [tile=16] [workers=n] [layout=linear|blocked|morton]\n", argv[0]);
+		return 1;
+	}
+	int dx = atoi(argv[2]);
+	int dy = atoi(argv[3]);
+	int dz = atoi(argv[4]);
+	CpuRaycastSettings settings;
+	bool compare = false;
+	VoxelLayout layout = VoxelLayout::Linear;
+	int args = argc;
+	for (; args > 7; args--) {
+		const char* flag = argv[args - 1];
+		if (strcmp(flag, "compare") == 0)
+			compare = true;
+		else if (strncmp(flag, "tile=", 5) == 0)
+			settings.tileSize = atoi(flag + 5);
+		else if (strncmp(flag, "workers=", 8) == 0)
+			settings.workers = (unsigned int)atoi(flag + 8);
+		else if (strncmp(flag, "layout=", 7) == 0) {
+			if (!parseVoxelLayout(flag + 7, layout))
+				fprintf(stderr, "Unknown layout %s, expected linear, blocked or morton\n", flag + 7);
+		}
+		else
+			break;
+	}
+	settings.width = settings.height = args > 7 ? atoi(argv[7]) : 512;
+	float angles[3] = { 0.0f, 0.0f, 0.0f };
+	for (int a = 0; a < 3 && 8 + a < args; a++)
+		angles[a] = (float)atof(argv[8 + a]);
+	for (int a = 0; a < 3; a++) {
+		float r[16];
+		rotation(a, angles[a], r);
+		multiply(settings.model, r, settings.model);
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	CpuVolume volume;
+	bool loaded = false;
+	switch (type)
+	{
+	case VoxelType::UInt8: loaded = loadVolume<unsigned char>(argv[1], dx, dy, dz, layout, volume); break;
+	case VoxelType::UInt16: loaded = loadVolume<unsigned short>(argv[1], dx, dy, dz, layout, volume); break;
+	case VoxelType::Int32: loaded = loadVolume<int>(argv[1], dx, dy, dz, layout, volume); break;
+	case VoxelType::Float32: loaded = loadVolume<float>(argv[1], dx, dy, dz, layout, volume); break;
+	}
+	if (!loaded)
+		return 1;
+	double loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	int width, height, channels;
+	std::vector<unsigned char> colormap;
+	unsigned char* png = stbi_load("res/textures/matplotlib-virdis.png", &width, &height, &channels, 4);
+	if (png) {
+		colormap.assign(png, png + width * 4);
+		stbi_image_free(png);
+	}
+	else {
+		for (int i = 0; i < 256; i++)
+			colormap.insert(colormap.end(), { (unsigned char)i, (unsigned char)i, (unsigned char)i, 255 });
+	}
+	int colormapSize = (int)colormap.size() / 4;
+
+	std::vector<unsigned char> image;
+	start = std::chrono::steady_clock::now();
+	TileStats tiles;
+	cpuRaycast(volume, colormap.data(), colormapSize, settings, image, &tiles);
+	double renderMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	printf("%dx%d in %.2f ms (%s), %s volume prepared in %.2f ms\n", settings.width, settings.height, renderMs,
+		cpuRaycastPackets() ? "8-ray AVX2 packets" : "one ray at a time", voxelLayoutName(layout), loadMs);
+	double minUtilization = 1.0, maxUtilization = 0.0;
+	uint64_t tileCount = 0, stolen = 0;
+	for (size_t w = 0; w < tiles.workers.size(); w++) {
+		minUtilization = std::min(minUtilization, tiles.utilization((int)w));
+		maxUtilization = std::max(maxUtilization, tiles.utilization((int)w));
+		tileCount += tiles.workers[w].tiles;
+		stolen += tiles.workers[w].stolen;
+	}
+	printf("%llu tiles of %d on %zu workers, utilization %.0f%% (worker min %.0f%%, max %.0f%%), %llu stolen\n",
+		(unsigned long long)tileCount, settings.tileSize, tiles.workers.size(), 100.0 * tiles.utilization(),
+		100.0 * minUtilization, 100.0 * maxUtilization, (unsigned long long)stolen);
+
+	if (compare && cpuRaycastPackets()) {
+		std::vector<unsigned char> reference;
+		settings.packets = false;
+		start = std::chrono::steady_clock::now();
+		cpuRaycast(volume, colormap.data(), colormapSize, settings, reference);
+		double referenceMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		int maxDiff = 0;
+		size_t differing = 0;
+		for (size_t i = 0; i < image.size(); i++) {
+			int diff = abs((int)image[i] - (int)reference[i]);
+			maxDiff = diff > maxDiff ? diff : maxDiff;
+			differing += diff != 0 ? 1 : 0;
+		}
+		printf("One ray at a time: %.2f ms; %zu of %zu channels differ, by at most %d\n", referenceMs, differing, image.size(), maxDiff);
+	}
+
+	if (!writePam(argv[6], settings.width, settings.height, image)) {
+		fprintf(stderr, "Could not write %s\n", argv[6]);
+		return 1;
+	}
+	return 0;
+}
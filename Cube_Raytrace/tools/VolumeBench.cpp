@@ -0,0 +1,205 @@
+// Micro-benchmarks for the volume ingest path.
+//
+//   g++ -O2 -mavx2 -mbmi2 -pthread -I.. VolumeBench.cpp ../VolumePrep.cpp ../VolumeLayout.cpp -o volumebench
+//   volumebench [dim]
+//
+// Times the original two scalar loops from Application.cpp against the
+// parallel SIMD kernels in VolumePrep.cpp on a synthetic dim^3 volume of
+// each voxel type and checks that both produce the same bytes.
+// Then marches rays in random directions, and rays along z, through a
+// float volume stored in each VoxelLayout and compares trilinear samples
+// per second; all layouts must sum to the same value.
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "parallel.hpp"
+#include "volumelayout.hpp"
+#include "volumeprep.hpp"
+
+template <typename Fn>
+static double timeMs(Fn fn, int repeats)
+{
+	double best = 1e30;
+	for (int r = 0; r < repeats; r++)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		fn();
+		auto stop = std::chrono::high_resolution_clock::now();
+		best = std::min(best, std::chrono::duration<double, std::milli>(stop - start).count());
+	}
+	return best;
+}
+
+template <typename T>
+static void legacyIngest(const T * fileBuf, size_t voxelCount, unsigned char * m_LocalBuffer)
+{
+	unsigned int r;
+	float min = fileBuf[0];
+	float max = fileBuf[0];
+
+	for (size_t i = 0; i < voxelCount; i++)
+	{
+
+		if (min > fileBuf[i])
+			min = fileBuf[i];
+		if (max < fileBuf[i])
+			max = fileBuf[i];
+	}
+
+	for (size_t i = 0; i < voxelCount; i++)
+	{
+		r = 255 * ((fileBuf[i] - min) / (max - min));
+		m_LocalBuffer[i] = (unsigned char)r;
+	}
+}
+
+template <typename T>
+static bool benchType(const char * name, size_t dim, T lo, T hi)
+{
+	size_t voxelCount = dim * dim * dim;
+	std::vector<T> volume(voxelCount);
+	srand(1);
+	for (size_t i = 0; i < voxelCount; i++)
+		volume[i] = (T)(lo + (hi - lo) * (rand() / (double)RAND_MAX));
+
+	std::vector<unsigned char> legacy(voxelCount), fast(voxelCount);
+	double legacyMs = timeMs([&]() { legacyIngest(volume.data(), voxelCount, legacy.data()); }, 3);
+	VolumeRange range = { 0.0f, 0.0f };
+	double rangeMs = timeMs([&]() { range = computeRange(volume.data(), voxelCount); }, 5);
+	double quantizeMs = timeMs([&]() { quantizeVolume(volume.data(), voxelCount, range, fast.data()); }, 5);
+
+	size_t mismatches = 0;
+	for (size_t i = 0; i < voxelCount; i++)
+		if (legacy[i] != fast[i])
+			mismatches++;
+
+	double mb = voxelCount * sizeof(T) / (1024.0 * 1024.0);
+	printf("%zu^3 %s (%.0f MB), %u threads\n", dim, name, mb, workerCount());
+	printf("  legacy loops      %8.2f ms  %7.1f MB/s\n", legacyMs, mb / legacyMs * 1000.0);
+	printf("  range + quantize  %8.2f ms  %7.1f MB/s  (range %.2f ms, quantize %.2f ms)\n",
+		rangeMs + quantizeMs, mb / (rangeMs + quantizeMs) * 1000.0, rangeMs, quantizeMs);
+	printf("  speedup           %8.2fx, %zu mismatching voxels\n", legacyMs / (rangeMs + quantizeMs), mismatches);
+	return mismatches == 0;
+}
+
+struct BenchRay
+{
+	float origin[3];
+	float dir[3];
+};
+
+// Half-voxel steps from the origin until the ray leaves the volume; the
+// sum of the samples of every ray, added up over rays in a fixed order.
+template <VoxelLayout L>
+static double marchRays(const float * values, const VoxelGrid & grid, const std::vector<BenchRay> & rays, size_t & out_samples)
+{
+	std::vector<double> sums(rays.size());
+	std::vector<size_t> counts(parallelChunkCount(rays.size(), 64));
+	parallelFor(0, rays.size(), 64, [&](size_t begin, size_t end, size_t chunk) {
+		size_t samples = 0;
+		float hi = (float)grid.dims[0] - 1.0f;
+		for (size_t r = begin; r < end; r++) {
+			const BenchRay& ray = rays[r];
+			double sum = 0.0;
+			float p[3] = { ray.origin[0], ray.origin[1], ray.origin[2] };
+			while (p[0] >= 0.0f && p[1] >= 0.0f && p[2] >= 0.0f && p[0] < hi && p[1] < hi && p[2] < hi) {
+				uint32_t x = (uint32_t)p[0], y = (uint32_t)p[1], z = (uint32_t)p[2];
+				sum += trilinear<L>(values, grid, x, y, z, p[0] - x, p[1] - y, p[2] - z);
+				samples++;
+				for (int a = 0; a < 3; a++)
+					p[a] += 0.5f * ray.dir[a];
+			}
+			sums[r] = sum;
+		}
+		counts[chunk] = samples;
+	});
+	out_samples = 0;
+	for (size_t c : counts)
+		out_samples += c;
+	double total = 0.0;
+	for (double s : sums)
+		total += s;
+	return total;
+}
+
+static bool benchLayouts(size_t dim, const char * name, const std::vector<BenchRay> & rays, const std::vector<float> & volume)
+{
+	printf("%zu %s rays through %zu^3 float32, %u threads, Morton codes by %s\n", rays.size(), name, dim, workerCount(),
+#ifdef MORTON_BMI2
+		"pdep");
+#else
+		"shifts and masks");
+#endif
+	bool ok = true;
+	double linearRate = 0.0, linearSum = 0.0;
+	const VoxelLayout layouts[] = { VoxelLayout::Linear, VoxelLayout::Blocked, VoxelLayout::Morton };
+	for (VoxelLayout layout : layouts) {
+		VoxelGrid grid = makeVoxelGrid(layout, (uint32_t)dim, (uint32_t)dim, (uint32_t)dim);
+		std::vector<float> values(grid.size);
+		double swizzleMs = timeMs([&]() {
+			swizzleVolume(volume.data(), (uint32_t)dim, (uint32_t)dim, (uint32_t)dim, grid, 0, 0, 0, values.data(), [](float v) { return v; });
+		}, 1);
+		size_t samples = 0;
+		double sum = 0.0;
+		double ms = timeMs([&]() {
+			switch (layout)
+			{
+			case VoxelLayout::Linear: sum = marchRays<VoxelLayout::Linear>(values.data(), grid, rays, samples); break;
+			case VoxelLayout::Blocked: sum = marchRays<VoxelLayout::Blocked>(values.data(), grid, rays, samples); break;
+			case VoxelLayout::Morton: sum = marchRays<VoxelLayout::Morton>(values.data(), grid, rays, samples); break;
+			}
+		}, 3);
+		double rate = samples / ms / 1000.0;
+		if (layout == VoxelLayout::Linear) {
+			linearRate = rate;
+			linearSum = sum;
+		}
+		bool same = sum == linearSum;
+		ok &= same;
+		printf("  %-8s %8.2f ms  %7.1f Msamples/s  %.2fx  (%.0f MB, swizzled in %.1f ms)%s\n", voxelLayoutName(layout), ms, rate,
+			rate / linearRate, grid.size * sizeof(float) / (1024.0 * 1024.0), swizzleMs, same ? "" : "  MISMATCH");
+	}
+	return ok;
+}
+
+static bool benchLayouts(size_t dim)
+{
+	size_t voxelCount = dim * dim * dim;
+	std::vector<float> volume(voxelCount);
+	srand(2);
+	for (size_t i = 0; i < voxelCount; i++)
+		volume[i] = rand() / (float)RAND_MAX;
+
+	std::vector<BenchRay> random(1 << 14), alongZ(1 << 14);
+	for (size_t r = 0; r < random.size(); r++) {
+		float len = 0.0f;
+		for (int a = 0; a < 3; a++) {
+			random[r].origin[a] = (dim - 1) * (rand() / (float)RAND_MAX);
+			random[r].dir[a] = rand() / (float)RAND_MAX - 0.5f;
+			len += random[r].dir[a] * random[r].dir[a];
+		}
+		len = len > 0.0f ? std::sqrt(len) : 1.0f;
+		for (int a = 0; a < 3; a++)
+			random[r].dir[a] /= len;
+		alongZ[r] = { { (dim - 1) * (rand() / (float)RAND_MAX), (dim - 1) * (rand() / (float)RAND_MAX), 0.0f }, { 0.0f, 0.0f, 1.0f } };
+	}
+	bool ok = benchLayouts(dim, "random", random, volume);
+	ok &= benchLayouts(dim, "z-aligned", alongZ, volume);
+	return ok;
+}
+
+int main(int argc, char* argv[])
+{
+	size_t dim = argc > 1 ? (size_t)atoi(argv[1]) : 256;
+	bool ok = true;
+	ok &= benchType<unsigned char>("uint8", dim, 0, 255);
+	ok &= benchType<unsigned short>("uint16", dim, 0, 4095);
+	ok &= benchType<int>("int32", dim, -1000, 39000);
+	ok &= benchType<float>("float32", dim, -1.0f, 3.0f);
+	ok &= benchLayouts(dim);
+	return ok ? 0 : 1;
+}
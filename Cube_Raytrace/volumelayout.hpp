@@ -0,0 +1,115 @@
+#ifndef VOLUMELAYOUT_H
+#define VOLUMELAYOUT_H
+#include <cstddef>
+#include <cstdint>
+
+#include "morton.hpp"
+#include "parallel.hpp"
+
+// Order voxels are stored in.
+// Linear is x fastest, then y, then z; a step along y or z lands a row or a
+// slice away, so rays that do not run along x touch a new cache line per
+// sample. Blocked stores 4x4x4 blocks of 64 voxels contiguously, the blocks
+// themselves in linear order. Morton follows the Z-order curve over the
+// grid rounded up to a power-of-two cube, which keeps neighbours close at
+// every scale but, for sizes just past a power of two, allocates up to 8x
+// the voxels.
+enum class VoxelLayout
+{
+	Linear,
+	Blocked,
+	Morton
+};
+
+bool parseVoxelLayout(const char * name, VoxelLayout & out_layout);
+const char* voxelLayoutName(VoxelLayout layout);
+
+// Addressing of a dims[0] x dims[1] x dims[2] grid. In every layout the
+// address of (x, y, z) is axisOffset(x, 0) + axisOffset(y, 1) +
+// axisOffset(z, 2), so the eight corners of a trilinear sample take six
+// axis offsets rather than eight full address computations.
+struct VoxelGrid
+{
+	VoxelLayout layout = VoxelLayout::Linear;
+	uint32_t dims[3] = { 0, 0, 0 };
+	// Linear: the distance between neighbours along each axis. Blocked: the
+	// distance between neighbouring blocks.
+	size_t stride[3] = { 0, 0, 0 };
+	// Elements to allocate.
+	size_t size = 0;
+};
+
+VoxelGrid makeVoxelGrid(VoxelLayout layout, uint32_t dx, uint32_t dy, uint32_t dz);
+
+template <VoxelLayout L>
+inline size_t axisOffset(const VoxelGrid & grid, uint32_t v, int axis)
+{
+	if (L == VoxelLayout::Morton)
+		return (size_t)mortonSpread3(v) << axis;
+	if (L == VoxelLayout::Blocked)
+		return (v >> 2) * grid.stride[axis] + ((size_t)(v & 3) << (2 * axis));
+	return v * grid.stride[axis];
+}
+
+template <VoxelLayout L>
+inline size_t voxelAddress(const VoxelGrid & grid, uint32_t x, uint32_t y, uint32_t z)
+{
+	return axisOffset<L>(grid, x, 0) + axisOffset<L>(grid, y, 1) + axisOffset<L>(grid, z, 2);
+}
+
+inline size_t voxelAddress(const VoxelGrid & grid, uint32_t x, uint32_t y, uint32_t z)
+{
+	switch (grid.layout)
+	{
+	case VoxelLayout::Blocked: return voxelAddress<VoxelLayout::Blocked>(grid, x, y, z);
+	case VoxelLayout::Morton: return voxelAddress<VoxelLayout::Morton>(grid, x, y, z);
+	default: return voxelAddress<VoxelLayout::Linear>(grid, x, y, z);
+	}
+}
+
+// Trilinear interpolation between the voxel at (x, y, z) and its +1
+// neighbours, with weights (fx, fy, fz) towards the latter.
+template <VoxelLayout L, typename T>
+inline float trilinear(const T * values, const VoxelGrid & grid, uint32_t x, uint32_t y, uint32_t z, float fx, float fy, float fz)
+{
+	size_t x0 = axisOffset<L>(grid, x, 0), x1 = axisOffset<L>(grid, x + 1, 0);
+	size_t y0 = axisOffset<L>(grid, y, 1), y1 = axisOffset<L>(grid, y + 1, 1);
+	size_t z0 = axisOffset<L>(grid, z, 2), z1 = axisOffset<L>(grid, z + 1, 2);
+	float c00 = values[x0 + y0 + z0] + (values[x1 + y0 + z0] - values[x0 + y0 + z0]) * fx;
+	float c10 = values[x0 + y1 + z0] + (values[x1 + y1 + z0] - values[x0 + y1 + z0]) * fx;
+	float c01 = values[x0 + y0 + z1] + (values[x1 + y0 + z1] - values[x0 + y0 + z1]) * fx;
+	float c11 = values[x0 + y1 + z1] + (values[x1 + y1 + z1] - values[x0 + y1 + z1]) * fx;
+	float c0 = c00 + (c10 - c00) * fy;
+	float c1 = c01 + (c11 - c01) * fy;
+	return c0 + (c1 - c0) * fz;
+}
+
+template <VoxelLayout L, typename T, typename U, typename Fn>
+inline void swizzleRow(const T * src, uint32_t dx, const VoxelGrid & grid, uint32_t ox, size_t rowAddress, U * out, Fn & fn)
+{
+	for (uint32_t x = 0; x < dx; x++)
+		out[rowAddress + axisOffset<L>(grid, x + ox, 0)] = fn(src[x]);
+}
+
+// Copies a linear dx*dy*dz volume into grid (whose dims may be larger) at
+// offset (ox, oy, oz), converting each voxel with fn. Slices are spread
+// over all cores.
+template <typename T, typename U, typename Fn>
+void swizzleVolume(const T * linear, uint32_t dx, uint32_t dy, uint32_t dz, const VoxelGrid & grid, uint32_t ox, uint32_t oy, uint32_t oz, U * out, Fn fn)
+{
+	parallelFor(0, dz, 1, [&](size_t zBegin, size_t zEnd, size_t) {
+		for (size_t z = zBegin; z < zEnd; z++)
+			for (uint32_t y = 0; y < dy; y++) {
+				const T* src = linear + (z * dy + y) * dx;
+				// x = 0 contributes nothing to the address in any layout.
+				size_t rowAddress = voxelAddress(grid, 0, y + oy, (uint32_t)z + oz);
+				switch (grid.layout)
+				{
+				case VoxelLayout::Linear: swizzleRow<VoxelLayout::Linear>(src, dx, grid, ox, rowAddress, out, fn); break;
+				case VoxelLayout::Blocked: swizzleRow<VoxelLayout::Blocked>(src, dx, grid, ox, rowAddress, out, fn); break;
+				case VoxelLayout::Morton: swizzleRow<VoxelLayout::Morton>(src, dx, grid, ox, rowAddress, out, fn); break;
+				}
+			}
+	});
+}
+#endif
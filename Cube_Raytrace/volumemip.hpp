@@ -0,0 +1,58 @@
+#ifndef VOLUMEMIP_H
+#define VOLUMEMIP_H
+#include <cstddef>
+#include <vector>
+
+#include "volumereader.hpp"
+
+// How a 2x2x2 footprint collapses into one texel of the next level.
+// Average is a box filter; Max keeps thin bright structures (vessels, bone
+// edges) visible at coarse levels instead of blurring them into the
+// background.
+enum class MipFilter
+{
+	None,
+	Average,
+	Max
+};
+
+bool parseMipFilter(const char * name, MipFilter & out_filter);
+const char* mipFilterName(MipFilter filter);
+
+// Number of levels down to 1x1x1, following the GL rule that each level is
+// max(1, floor(previous / 2)) along every axis.
+int mipLevelCount(int dx, int dy, int dz);
+
+// Levels 1..n-1 of a volume; level 0 is the source itself and is never
+// copied. dims holds all n levels, dims[0] being the source's.
+template <typename T>
+struct VolumeMip
+{
+	MipFilter filter = MipFilter::None;
+	std::vector<std::vector<T>> levels;
+	std::vector<int> dims;
+
+	int levelCount() const { return (int)dims.size() / 3; }
+	const int* levelDims(int level) const { return &dims[level * 3]; }
+	const T* levelData(int level) const { return levels[level - 1].data(); }
+};
+
+// Builds the whole pyramid on all cores, one contiguous run of output
+// slices per worker. A texel whose footprint runs past an odd edge takes in
+// the leftover voxels, so nothing of the source is dropped.
+template <typename T>
+void buildVolumeMip(const T * voxels, int dx, int dy, int dz, MipFilter filter, VolumeMip<T> & out);
+
+// The pyramid is written next to the raw file as <path>.mip and reused while
+// the source's size and modification time still match, so it is computed
+// once per volume rather than on every start.
+template <typename T>
+bool loadVolumeMip(const char * path, int dx, int dy, int dz, MipFilter filter, VolumeMip<T> & out);
+template <typename T>
+bool saveVolumeMip(const char * path, const VolumeMip<T> & mip);
+
+// loadVolumeMip() or, when there is no usable cache, buildVolumeMip()
+// followed by saveVolumeMip().
+template <typename T>
+void ingestVolumeMip(const char * path, const T * voxels, int dx, int dy, int dz, MipFilter filter, VolumeMip<T> & out);
+#endif
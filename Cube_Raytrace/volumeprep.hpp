@@ -0,0 +1,24 @@
+#ifndef VOLUMEPREP_H
+#define VOLUMEPREP_H
+#include <cstddef>
+
+// Value range of a volume, as used for window/level normalization.
+struct VolumeRange
+{
+	float min;
+	float max;
+};
+
+// Both kernels split the volume across all cores and use AVX2 or SSE4.1
+// when the translation unit is built with them (/arch:AVX2, -mavx2,
+// -msse4.1), falling back to scalar loops otherwise.
+// Instantiated for unsigned char, unsigned short, int and float; each voxel
+// type gets its own load/compare kernel, there is no per-voxel type switch.
+template <typename T>
+VolumeRange computeRange(const T * voxels, size_t count);
+
+// out[i] = 255 * ((voxels[i] - min) / (max - min)), truncated; bit-identical
+// to the scalar loop it replaces. A flat volume quantizes to 0.
+template <typename T>
+void quantizeVolume(const T * voxels, size_t count, VolumeRange range, unsigned char * out);
+#endif
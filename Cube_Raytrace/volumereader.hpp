@@ -0,0 +1,77 @@
+#ifndef VOLUMEREADER_H
+#define VOLUMEREADER_H
+#include <stdio.h>
+#include <cstddef>
+
+#include "volumeprep.hpp"
+#include "volumesource.hpp"
+
+enum class VoxelType
+{
+	UInt8,
+	UInt16,
+	Int32,
+	Float32
+};
+
+// Accepts "uint8", "uint16", "int32", "float32" and the GL_UNSIGNED_BYTE,
+// GL_UNSIGNED_SHORT, GL_INT, GL_FLOAT spellings used on the command line.
+bool parseVoxelType(const char * name, VoxelType & out_type);
+const char* voxelTypeName(VoxelType type);
+size_t voxelSize(VoxelType type);
+
+template <typename T> struct VoxelTraits;
+template <> struct VoxelTraits<unsigned char> { static const VoxelType type = VoxelType::UInt8; };
+template <> struct VoxelTraits<unsigned short> { static const VoxelType type = VoxelType::UInt16; };
+template <> struct VoxelTraits<int> { static const VoxelType type = VoxelType::Int32; };
+template <> struct VoxelTraits<float> { static const VoxelType type = VoxelType::Float32; };
+
+// Typed reader over a mapped raw volume of dx*dy*dz voxels of T.
+// All per-voxel work goes through the kernels instantiated for T in
+// VolumePrep.cpp, so there is no per-voxel type dispatch anywhere.
+template <typename T>
+class VolumeReader
+{
+public:
+	VolumeReader() = default;
+	VolumeReader(const VolumeReader&) = delete;
+	VolumeReader& operator=(const VolumeReader&) = delete;
+	~VolumeReader() { close(); }
+
+	bool open(const char * path, int dx, int dy, int dz)
+	{
+		close();
+		if (!mapVolume(path, m_Source))
+			return false;
+		m_Dims[0] = dx;
+		m_Dims[1] = dy;
+		m_Dims[2] = dz;
+		m_Count = (size_t)dx * dy * dz;
+		if (volumeCount<T>(m_Source) < m_Count) {
+			printf("Volume %s holds %zu bytes, expected %dx%dx%d %s voxels\n",
+				path, m_Source.size, dx, dy, dz, voxelTypeName(VoxelTraits<T>::type));
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void close()
+	{
+		unmapVolume(m_Source);
+		m_Count = 0;
+	}
+
+	const T* voxels() const { return volumeData<T>(m_Source); }
+	size_t voxelCount() const { return m_Count; }
+	const int* dims() const { return m_Dims; }
+	const VolumeSource& source() const { return m_Source; }
+
+	VolumeRange range() const { return computeRange(voxels(), m_Count); }
+
+private:
+	VolumeSource m_Source;
+	int m_Dims[3] = { 0, 0, 0 };
+	size_t m_Count = 0;
+};
+#endif
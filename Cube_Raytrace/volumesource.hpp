@@ -0,0 +1,50 @@
+#ifndef VOLUMESOURCE_H
+#define VOLUMESOURCE_H
+#include <cstddef>
+
+// How the mapped voxels are going to be walked; forwarded to the kernel as
+// a readahead hint (madvise on POSIX, scan flags on Windows).
+enum class VolumeAccess
+{
+	Sequential,
+	Random
+};
+
+// A raw volume file mapped read-only into the address space.
+// Consumers read the voxels in place through volumeData<T>() instead of
+// copying the file into a heap buffer first, so pages are only faulted in
+// when a stage actually touches them.
+struct VolumeSource
+{
+	const unsigned char* data = nullptr;
+	size_t size = 0;
+#ifdef _WIN32
+	void* file = nullptr;
+	void* mapping = nullptr;
+#else
+	int fd = -1;
+#endif
+};
+
+bool mapVolume(
+	const char * path,
+	VolumeSource & out_source,
+	VolumeAccess access = VolumeAccess::Sequential
+);
+void adviseVolume(const VolumeSource & source, VolumeAccess access);
+void unmapVolume(VolumeSource & source);
+
+// Typed view of the mapping, starting offset bytes into the file.
+template <typename T>
+const T* volumeData(const VolumeSource & source, size_t offset = 0)
+{
+	return reinterpret_cast<const T*>(source.data + offset);
+}
+
+// Number of whole T elements available after offset.
+template <typename T>
+size_t volumeCount(const VolumeSource & source, size_t offset = 0)
+{
+	return offset < source.size ? (source.size - offset) / sizeof(T) : 0;
+}
+#endif
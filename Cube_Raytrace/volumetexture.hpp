@@ -0,0 +1,77 @@
+#ifndef VOLUMETEXTURE_H
+#define VOLUMETEXTURE_H
+#include <GL/glew.h>
+#include <cstddef>
+
+#include "brickvolume.hpp"
+#include "gradientvolume.hpp"
+#include "macrocells.hpp"
+#include "volumemip.hpp"
+#include "volumereader.hpp"
+
+// Single-channel GL format a voxel type is uploaded as.
+// uint8 -> GL_R8, uint16 -> GL_R16, float32 -> GL_R32F (or GL_R16F when
+// half precision is requested). int32 has no filterable integer format and
+// is converted to GL_R32F slab by slab during upload.
+struct VolumeTextureFormat
+{
+	GLenum internalFormat;
+	GLenum format;
+	GLenum type;
+	size_t bytesPerTexel;
+	// Multiplying a sample by this gives the value in data units
+	// (UNORM formats come back divided by 255 / 65535).
+	float valueScale;
+	const char* name;
+};
+
+VolumeTextureFormat selectVolumeTextureFormat(VoxelType type, bool halfFloat);
+
+struct VolumeTexture
+{
+	unsigned int id = 0;
+	int dims[3] = { 0, 0, 0 };
+	VolumeTextureFormat format;
+	VolumeRange range = { 0.0f, 0.0f };
+	// Mip levels allocated, 1 when the volume has no pyramid.
+	int levels = 1;
+	size_t residentBytes = 0;
+	// Min/max of every macro-cell, built alongside the upload.
+	MacroCellGrid cells;
+	// Precomputed gradients (0 when not requested); gradientScale turns a
+	// decoded gradient into texture units like a difference of two samples.
+	unsigned int gradientId = 0;
+	GradientFormat gradientFormat = GradientFormat::RGBA8;
+	float gradientScale = 0.0f;
+};
+
+// Maps the raw volume, computes its range and uploads it in its native
+// precision directly out of the mapping, one slab of slices at a time.
+// Unless mips is MipFilter::None the full pyramid is ingested as well (see
+// ingestVolumeMip) and the texture samples with GL_LINEAR_MIPMAP_LINEAR.
+// With gradients enabled the gradient volume is built from the same
+// mapping and uploaded next to it.
+bool createVolumeTexture(
+	const char * path,
+	int dx, int dy, int dz,
+	VoxelType type,
+	bool halfFloat,
+	MipFilter mips,
+	const GradientSettings & gradients,
+	VolumeTexture & out_texture
+);
+// Same for a bricked volume, reading only the bricks whose max exceeds
+// minVisible (data units) and filling the rest with the volume minimum.
+bool createVolumeTexture(
+	const BrickVolume & volume,
+	float minVisible,
+	bool halfFloat,
+	const GradientSettings & gradients,
+	VolumeTexture & out_texture
+);
+void deleteVolumeTexture(VolumeTexture & texture);
+
+// Window/level (in data units) as the u_WindowLow / u_WindowScale pair the
+// raymarch shader applies to raw samples: val = (sample - low) * scale.
+void windowUniforms(const VolumeTexture & texture, float level, float width, float & out_low, float & out_scale);
+#endif
@@ -8,10 +8,17 @@
 #include <string>
 #include <sstream>
 #include <assert.h>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
 #include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp"
 #include "glm/gtc/type_ptr.hpp"
 #include "glm/gtx/string_cast.hpp"
+// From ../Cube_Raytrace, built with its GLContext.cpp, PngWriter.cpp and Renderer.cpp.
+#include "glcontext.hpp"
+#include "pngwriter.hpp"
 glm::mat4 u_MVP;
 glm::mat4 rotate = glm::mat4(1.0f);
 float ang = 0.0f;
@@ -169,41 +176,46 @@ static unsigned int CompileShader(unsigned int type, const std::string& source)
 	return id;
 }
 
-int main(void)
+int main(int argc, char* argv[])
 {
-	if (!glfwInit())
+	// "headless" renders into an offscreen framebuffer through EGL, as does
+	// a machine on which no window can be opened. "frames=<n>" stops after
+	// n frames, one by default when headless, and "screenshot=<png>" saves
+	// the last of them.
+	bool headless = false;
+	int frameLimit = 0;
+	const char* screenshotPath = nullptr;
+	for (int i = 1; i < argc; i++)
 	{
-		fprintf(stderr, "Failed to initialize GLFW\n");
-		getchar();
-		return -1;
+		if (strcmp(argv[i], "headless") == 0)
+			headless = true;
+		else if (strncmp(argv[i], "frames=", 7) == 0)
+			frameLimit = atoi(argv[i] + 7);
+		else if (strncmp(argv[i], "screenshot=", 11) == 0)
+			screenshotPath = argv[i] + 11;
 	}
-
-	glfwWindowHint(GLFW_SAMPLES, 4);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-	window = glfwCreateWindow(1024, 768, "Tutorial 02 - Red triangle", NULL, NULL);
-	if (window == NULL) {
-		fprintf(stderr, "Failed to open GLFW window. If you have an Intel GPU, they are not 3.3 compatible. Try the 2.1 version of the tutorials.\n");
-		getchar();
-		glfwTerminate();
-		return -1;
+	std::unique_ptr<GLContext> context;
+	if (!headless)
+		context = createGLContext(GLContextBackend::Window, 1024, 768, "Tutorial 02 - Red triangle");
+	if (!context) {
+		if (!headless)
+			fprintf(stderr, "Falling back to a headless context\n");
+		context = createGLContext(GLContextBackend::Headless, 1024, 768, "Tutorial 02 - Red triangle");
 	}
-	glfwMakeContextCurrent(window);
-	glfwSetKeyCallback(window, keyCallback);
-	glfwSetInputMode(window, GLFW_STICKY_KEYS, 1);
-
-
-	// Initialize GLEW
-	glewExperimental = true;
-	if (glewInit() != GLEW_OK) {
-		fprintf(stderr, "Failed to initialize GLEW\n");
+	if (!context) {
 		getchar();
-		glfwTerminate();
 		return -1;
 	}
-	glfwSetInputMode(window, GLFW_STICKY_KEYS, GL_TRUE);
+	// Nothing moves without input, so headless one frame shows it all.
+	if (context->backend() == GLContextBackend::Headless && frameLimit == 0)
+		frameLimit = 1;
+	window = context->window();
+	if (window) {
+		glfwSetKeyCallback(window, keyCallback);
+		glfwSetInputMode(window, GLFW_STICKY_KEYS, GL_TRUE);
+	}
+	// Frames go to the window or, headless, to the offscreen target.
+	GLCall(glBindFramebuffer(GL_FRAMEBUFFER, context->framebuffer()));
 
 
 	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
@@ -357,6 +369,7 @@ int main(void)
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	glMatrixMode(GL_MODELVIEW);
 
+	int frame = 0;
 	do {
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 		glm::mat4 trans = glm::translate(modell, key_brd);
@@ -374,18 +387,29 @@ int main(void)
 		}
 		rotate = glm::rotate(glm::mat4(1.0f), ang, glm::vec3(0.0f, 0.0f, 1.0f));
 		modell = modell * rotate;
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+		frame++;
+		// A window's back buffer is undefined after the swap, so the last
+		// frame is saved before it.
+		if (screenshotPath && frame == frameLimit) {
+			int width, height;
+			std::vector<unsigned char> pixels;
+			context->framebufferSize(width, height);
+			context->readPixels(pixels);
+			if (writePng(screenshotPath, width, height, pixels.data()))
+				printf("Saved frame %d to %s\n", frame, screenshotPath);
+			else
+				fprintf(stderr, "Could not write %s\n", screenshotPath);
+		}
+		context->present();
 
-	} while (glfwGetKey(window, GLFW_KEY_ESCAPE) != GLFW_PRESS &&
-		glfwWindowShouldClose(window) == 0);
+	} while (!context->shouldClose() && (frameLimit == 0 || frame < frameLimit) &&
+		(!window || glfwGetKey(window, GLFW_KEY_ESCAPE) != GLFW_PRESS));
 
 	glDepthMask(GL_TRUE);
 	glDisable(GL_BLEND);
 	GLCall(glDeleteBuffers(1, &buffer));
 	GLCall(glDeleteVertexArrays(1, &vao));
 	GLCall(glDeleteProgram(shader));
-	glfwTerminate();
 	return 0;
 }
 void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods)
@@ -8,10 +8,17 @@
 #include <string>
 #include <sstream>
 #include <assert.h>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
 #include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp"
 #include "glm/vec3.hpp"
 #include "glm/mat4x4.hpp"
+// From ../Cube_Raytrace, built with its GLContext.cpp, PngWriter.cpp and Renderer.cpp.
+#include "glcontext.hpp"
+#include "pngwriter.hpp"
 #define ASSERT(x) if (!(x)) assert(false)
 
 #define GLCall(x) GLClearError();\
@@ -90,38 +97,45 @@ static unsigned int CompileShader(unsigned int type, const std::string& source)
 	return id;
 }
 
-int main(void)
+int main(int argc, char* argv[])
 {
-	if (!glfwInit())
+	// "headless" renders into an offscreen framebuffer through EGL, as does
+	// a machine on which no window can be opened. "frames=<n>" stops after
+	// n frames, one by default when headless, and "screenshot=<png>" saves
+	// the last of them.
+	bool headless = false;
+	int frameLimit = 0;
+	const char* screenshotPath = nullptr;
+	for (int i = 1; i < argc; i++)
 	{
-		fprintf(stderr, "Failed to initialize GLFW\n");
-		getchar();
-		return -1;
+		if (strcmp(argv[i], "headless") == 0)
+			headless = true;
+		else if (strncmp(argv[i], "frames=", 7) == 0)
+			frameLimit = atoi(argv[i] + 7);
+		else if (strncmp(argv[i], "screenshot=", 11) == 0)
+			screenshotPath = argv[i] + 11;
 	}
-
-	glfwWindowHint(GLFW_SAMPLES, 4);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-	GLFWwindow* window = glfwCreateWindow(1024, 768, "Tutorial 02 - Red triangle", NULL, NULL);
-	if (window == NULL) {
-		fprintf(stderr, "Failed to open GLFW window. If you have an Intel GPU, they are not 3.3 compatible. Try the 2.1 version of the tutorials.\n");
-		getchar();
-		glfwTerminate();
-		return -1;
+	std::unique_ptr<GLContext> context;
+	if (!headless)
+		context = createGLContext(GLContextBackend::Window, 1024, 768, "Tutorial 02 - Red triangle");
+	if (!context) {
+		if (!headless)
+			fprintf(stderr, "Falling back to a headless context\n");
+		context = createGLContext(GLContextBackend::Headless, 1024, 768, "Tutorial 02 - Red triangle");
 	}
-	glfwMakeContextCurrent(window);
-
-	// Initialize GLEW
-	glewExperimental = true;
-	if (glewInit() != GLEW_OK) {
-		fprintf(stderr, "Failed to initialize GLEW\n");
+	if (!context) {
 		getchar();
-		glfwTerminate();
 		return -1;
 	}
-	glfwSetInputMode(window, GLFW_STICKY_KEYS, GL_TRUE);
+	// Nothing moves without input, so headless one frame shows it all.
+	if (context->backend() == GLContextBackend::Headless && frameLimit == 0)
+		frameLimit = 1;
+	GLFWwindow* window = context->window();
+	if (window) {
+		glfwSetInputMode(window, GLFW_STICKY_KEYS, GL_TRUE);
+	}
+	// Frames go to the window or, headless, to the offscreen target.
+	GLCall(glBindFramebuffer(GL_FRAMEBUFFER, context->framebuffer()));
 
 
 	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
@@ -286,6 +300,7 @@ int main(void)
 
 	//GLCall(glUniform4f(u_Color, 0.0, 0.2, 0.8, 0.2));
 
+		int frame = 0;
 		do {
 			for (int i = 0; i <6; i++)
 			{
@@ -296,11 +311,23 @@ int main(void)
 				GLCall(glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr));
 				
 			}
-			glfwSwapBuffers(window);
-			glfwPollEvents();
+			frame++;
+			// A window's back buffer is undefined after the swap, so the last
+			// frame is saved before it.
+			if (screenshotPath && frame == frameLimit) {
+				int width, height;
+				std::vector<unsigned char> pixels;
+				context->framebufferSize(width, height);
+				context->readPixels(pixels);
+				if (writePng(screenshotPath, width, height, pixels.data()))
+					printf("Saved frame %d to %s\n", frame, screenshotPath);
+				else
+					fprintf(stderr, "Could not write %s\n", screenshotPath);
+			}
+			context->present();
 
-		} while (glfwGetKey(window, GLFW_KEY_ESCAPE) != GLFW_PRESS &&
-			glfwWindowShouldClose(window) == 0);
+		} while (!context->shouldClose() && (frameLimit == 0 || frame < frameLimit) &&
+			(!window || glfwGetKey(window, GLFW_KEY_ESCAPE) != GLFW_PRESS));
 	
 		glDepthMask(GL_TRUE);
 		glDisable(GL_BLEND);
@@ -309,7 +336,6 @@ int main(void)
 	GLCall(glDeleteProgram(shader));
 
 	
-	glfwTerminate();
 
 	return 0;
 }
\ No newline at end of file